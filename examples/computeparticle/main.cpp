@@ -162,7 +162,7 @@ void on_draw(oval_device_t* device, HGEGraphics::rendergraph_t& rg, HGEGraphics:
 
 		auto particl_update_ubo_handle = rendergraph_declare_uniform_buffer_quick(&rg, sizeof(ParticleUpdateData), &app->particle_update_data);
 
-		auto upvPassBuilder = rendergraph_add_computepass(&rg, "update particle vertex");
+		auto upvPassBuilder = rendergraph_add_computepass(&rg, "update particle vertex", CGPU_QUEUE_TYPE_COMPUTE);
 		computepass_readwrite_buffer(&upvPassBuilder, particle_vertex_buffer_handle);
 		computepass_use_buffer(&upvPassBuilder, particl_update_ubo_handle);
 		struct ComputePassPassData
@@ -234,6 +234,7 @@ int SDL_main(int argc, char *argv[])
 		.height = height,
 		.enable_capture = false,
 		.enable_profile = false,
+		.async_compute = true,
 	};
 	app.device = oval_create_device(&device_descriptor);
 	_init_resource(app);
@@ -420,6 +420,8 @@ struct Application
 	CGPUSamplerId texture_sampler = CGPU_NULLPTR;
 	HGEGraphics::Texture* color_map{ nullptr };
 	std::vector<HGEGraphics::Material*> materials;
+	HGEGraphics::Shader* object_shader{ nullptr };
+	uint32_t object_index_constant{ 0 };
 	std::pmr::synchronized_pool_resource root_memory_resource;
 	std::array<FrameRenderPacket, 2> frameRenderPackets;
 	MM::EntityEditor<entt::entity> enttEditor;
@@ -978,11 +980,14 @@ void _init_resource(Application& app)
 	app.color_map = oval_load_texture(app.device, "media/textures/tex.jpg", true);
 
 	load_scene(app, "media/gltf/gltf-truck/CesiumMilkTruck.gltf", shader);
+	app.object_shader = shader;
+	app.object_index_constant = HGEGraphics::push_constant_index(shader, "pushConstants");
 }
 
 void _free_resource(Application& app)
 {
 	app.materials.clear();
+	app.object_shader = nullptr;
 	app.color_map = nullptr;
 	app.texture_sampler = nullptr;
 }
@@ -1216,21 +1221,27 @@ void submit(Application& app, FrameRenderPacket& lastFrameRenderPacket, oval_dev
 	for (auto& view : lastFrameRenderPacket.viewDatas)
 	{
 		auto pass_ubo_handle = rendergraph_declare_uniform_buffer_quick(&rg, sizeof(PassData), &view.passData);
-		auto object_ubo_handle = rendergraph_declare_uniform_buffer_quick(&rg, view.renderData.size() * sizeof(ObjectData), view.renderData.data());
+		// every draw of the view reads its object from this one buffer by the index it pushes
+		uint32_t object_data_size = std::max<uint32_t>(view.renderData.size(), 1) * sizeof(ObjectData);
+		auto object_buffer_handle = rendergraph_declare_buffer(&rg);
+		rg_buffer_set_size(&rg, object_buffer_handle, object_data_size);
+		rg_buffer_set_type(&rg, object_buffer_handle, CGPU_RESOURCE_TYPE_BUFFER);
+		rg_buffer_set_usage(&rg, object_buffer_handle, CGPU_MEMORY_USAGE_GPU_ONLY);
+		rendergraph_add_uploadbufferpass_ex(&rg, "upload object data", object_buffer_handle, view.renderData.size() * sizeof(ObjectData), 0, view.renderData.data(), nullptr, 0, nullptr);
 
 		auto passBuilder = rendergraph_add_renderpass(&rg, "Main Pass");
 		uint32_t color = 0xff000000;
 		renderpass_add_color_attachment(&passBuilder, rg_back_buffer, firstView ? ECGPULoadAction::CGPU_LOAD_ACTION_CLEAR : ECGPULoadAction::CGPU_LOAD_ACTION_LOAD, color, ECGPUStoreAction::CGPU_STORE_ACTION_STORE);
 		renderpass_add_depth_attachment(&passBuilder, depth_handle, CGPU_LOAD_ACTION_CLEAR, 0, CGPU_STORE_ACTION_DISCARD, CGPU_LOAD_ACTION_CLEAR, 0, CGPU_STORE_ACTION_DISCARD);
 		renderpass_use_buffer(&passBuilder, pass_ubo_handle);
-		renderpass_use_buffer(&passBuilder, object_ubo_handle);
+		renderpass_use_buffer(&passBuilder, object_buffer_handle);
 
 		struct MainPassPassData
 		{
 			Application* app;
 			ViewRenderPacket* view;
 			HGEGraphics::buffer_handle_t pass_ubo_handle;
-			HGEGraphics::buffer_handle_t object_ubo_handle;
+			HGEGraphics::buffer_handle_t object_buffer_handle;
 		};
 		MainPassPassData* passdata;
 		renderpass_set_executable(&passBuilder, [](RenderPassEncoder* encoder, void* passdata)
@@ -1238,17 +1249,18 @@ void submit(Application& app, FrameRenderPacket& lastFrameRenderPacket, oval_dev
 				MainPassPassData* resolved_passdata = (MainPassPassData*)passdata;
 				Application& app = *resolved_passdata->app;
 				set_global_dynamic_buffer(encoder, resolved_passdata->pass_ubo_handle, 0, 0);
-				for (size_t i = 0; i < resolved_passdata->view->renderObjects.size(); ++i)
+				set_global_dynamic_buffer(encoder, resolved_passdata->object_buffer_handle, 2, 0);
+				for (uint32_t i = 0; i < resolved_passdata->view->renderObjects.size(); ++i)
 				{
 					auto& obj = resolved_passdata->view->renderObjects[i];
-					set_global_buffer_with_offset_size(encoder, resolved_passdata->object_ubo_handle, 2, 0, i * sizeof(ObjectData), sizeof(ObjectData));
+					push_constants(encoder, app.object_shader, app.object_index_constant, &i);
 					draw(encoder, app.materials[obj.material], app.meshes[obj.mesh]);
 				}
 			}, sizeof(MainPassPassData), (void**)&passdata);
 		passdata->app = &app;
 		passdata->view = &view;
 		passdata->pass_ubo_handle = pass_ubo_handle;
-		passdata->object_ubo_handle = object_ubo_handle;
+		passdata->object_buffer_handle = object_buffer_handle;
 
 		firstView = false;
 	}
@@ -27,6 +27,7 @@ namespace HGEGraphics
 	protected:
 		BufferWrap* getResource_impl(const CGPUBufferDescriptor& descriptor) override;
 		void destroyResource_impl(BufferWrap* resource) override;
+		uint64_t resourceSize(const CGPUBufferDescriptor& descriptor) const override;
 
 	private:
 		CGPUDeviceId device{ CGPU_NULLPTR };
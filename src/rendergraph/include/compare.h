@@ -4,25 +4,6 @@
 
 namespace HGEGraphics
 {
-	inline bool operator==(const CGPUVertexLayout& a, const CGPUVertexLayout& b)
-	{
-		return a.attribute_count == b.attribute_count && a.p_attributes == b.p_attributes;
-	}
-
-	inline bool operator==(const CGPUBlendStateDescriptor& a, const CGPUBlendStateDescriptor& b)
-	{
-		return a.attachment_count == b.attachment_count && a.p_attachments == b.p_attachments
-			&& a.alpha_to_coverage == b.alpha_to_coverage && a.independent_blend == b.independent_blend;
-	}
-
-	inline bool operator==(const CGPURasterizerStateDescriptor& a, const CGPURasterizerStateDescriptor& b)
-	{
-		return a.cull_mode == b.cull_mode && a.depth_bias == b.depth_bias
-			&& a.slope_scaled_depth_bias == b.slope_scaled_depth_bias && a.fill_mode == b.fill_mode 
-			&& a.front_face == b.front_face && a.enable_multi_sample == b.enable_multi_sample
-			&& a.enable_scissor == b.enable_scissor && a.enable_depth_clamp == b.enable_depth_clamp;
-	}
-
 	inline bool operator==(const CGPUDescriptorData& a, const CGPUDescriptorData& b)
 	{
 		return a.name == b.name && a.binding == b.binding && a.binding_type == b.binding_type
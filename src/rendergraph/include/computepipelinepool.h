@@ -4,10 +4,13 @@
 #include "cgpu/api.h"
 #include "hash.h"
 #include <string.h>
+#include <unordered_map>
+#include <mutex>
 
 namespace HGEGraphics
 {
 	struct ComputeShader;
+	class PipelineCache;
 
 	using CPSOKey = ComputeShader*;
 
@@ -28,14 +31,31 @@ namespace HGEGraphics
 		ComputePipelinePool(CGPUDeviceId device, ComputePipelinePool* upstream, std::pmr::memory_resource* const memory_resource);
 
 		ComputePipeline* getComputePipeline(ComputeShader* shader);
+		// the mutex guards this pool and its upstreams, it is only held for the lookups, a missing pipeline is created
+		// without it
+		ComputePipeline* getComputePipeline(ComputeShader* shader, std::mutex& mutex);
+
+		// pipelines created are recorded in the cache, and in the manifest while there is one
+		void setPipelineCache(PipelineCache* cache) { pipeline_cache = cache; }
+		void setPipelineManifest(PipelineCache* manifest) { pipeline_manifest = manifest; }
 
 		// ͨ ResourcePool ̳
 		virtual ComputePipeline* getResource_impl(const CPSOKey& descriptor) override;
 
 		virtual void destroyResource_impl(ComputePipeline* resource) override;
 
+		CGPUComputePipelineId createPipeline(const CPSOKey& key) const;
+		void destroy();
+
 	private:
+		// the pool at the end of the upstreams, the only one creating pipelines
+		ComputePipelinePool* creator() { return m_upstream ? static_cast<ComputePipelinePool*>(m_upstream)->creator() : this; }
+
 		CGPUDeviceId device{ CGPU_NULLPTR };
+		PipelineCache* pipeline_cache{ nullptr };
+		PipelineCache* pipeline_manifest{ nullptr };
+		// created outside the lock and not requested yet
+		std::pmr::unordered_map<CPSOKey, CGPUComputePipelineId> prepared_pipelines;
 		std::pmr::polymorphic_allocator<> allocator;
 	};
 }
\ No newline at end of file
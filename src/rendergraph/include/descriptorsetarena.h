@@ -0,0 +1,70 @@
+#pragma once
+
+#include "cgpu/api.h"
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+
+namespace HGEGraphics
+{
+	struct DescriptorSetArenaStats
+	{
+		uint32_t arena_count = 0;
+		// sets handed out since the last reset, and the most handed out by one frame
+		uint64_t acquired = 0;
+		uint64_t peak_acquired = 0;
+		// sets alive in all arenas, and how many had to be created since the arenas were made
+		uint64_t resident = 0;
+		uint64_t created = 0;
+	};
+
+	// descriptor sets of one recording thread and one frame in flight. every set index of every root signature has an
+	// arena of sets handed out in order, all of them are taken back at once by reset when the frame has finished on
+	// the gpu. arenas of root signatures not used for a while are freed at reset
+	class DescriptorSetArenas
+	{
+	public:
+		DescriptorSetArenas(CGPUDeviceId device, std::pmr::memory_resource* const memory_resource);
+
+		static constexpr uint32_t max_set_count = 4;
+
+		CGPUDescriptorSetId acquire(CGPURootSignatureId root_signature, uint32_t set_index);
+
+		// the work using the sets handed out must be finished
+		void reset();
+		// before the root signatures are freed
+		void destroy();
+
+		void setFramesBeforeOutOfDate(uint64_t frames) { frames_before_out_of_date = frames; }
+		DescriptorSetArenaStats stats() const;
+
+	private:
+		struct Arena
+		{
+			std::pmr::vector<CGPUDescriptorSetId> sets;
+			uint32_t used = 0;
+		};
+
+		struct RootSignatureArenas
+		{
+			RootSignatureArenas(std::pmr::memory_resource* const memory_resource);
+
+			Arena arenas[max_set_count];
+			uint64_t timestamp = 0;
+		};
+
+		CGPUDeviceId device{ CGPU_NULLPTR };
+		std::pmr::memory_resource* memory_resource;
+		std::pmr::unordered_map<CGPURootSignatureId, RootSignatureArenas> root_signatures;
+		// draws mostly come in runs of one shader
+		CGPURootSignatureId last_root_signature{ CGPU_NULLPTR };
+		RootSignatureArenas* last_arenas = nullptr;
+		uint64_t timestamp = 0;
+		uint64_t frames_before_out_of_date = 10;
+		uint64_t acquired = 0;
+		uint64_t peak_acquired = 0;
+		uint64_t resident = 0;
+		uint64_t created = 0;
+	};
+}
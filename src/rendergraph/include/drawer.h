@@ -19,6 +19,9 @@ namespace HGEGraphics
 	void set_viewport(RenderPassEncoder* encoder, float x, float y, float width, float height, float min_depth, float max_depth);
 	void set_scissor(RenderPassEncoder* encoder, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 	void push_constants(RenderPassEncoder* encoder, Shader* shader, const char* name, const void* data);
+	// looked up once, for push_constants by index at every draw
+	uint32_t push_constant_index(const Shader* shader, const char* name);
+	void push_constants(RenderPassEncoder* encoder, Shader* shader, uint32_t index, const void* data);
 	void draw(RenderPassEncoder* encoder, Shader* shader, Mesh* mesh);
 	void draw_submesh(RenderPassEncoder* encoder, Shader* shader, Mesh* mesh, uint32_t index_count, uint32_t first_index, uint32_t vertex_count, uint32_t first_vertex);
 	void draw_procedure(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology mesh_topology, uint32_t vertex_count);
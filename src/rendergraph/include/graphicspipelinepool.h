@@ -5,43 +5,46 @@
 #include "hash.h"
 #include <string.h>
 #include "compare.h"
+#include <string>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+namespace tf
+{
+	class Executor;
+}
 
 namespace HGEGraphics
 {
 	struct Shader;
 	struct Mesh;
 	struct RenderPassEncoder;
-
+	struct GraphicsPipelineDescription;
+	class PipelineCache;
+	struct RenderPass;
+	// the states are ids of the pipeline state registry, so the key is compared and hashed as plain words
 	struct PSOKey
 	{
 		Shader* shader;
-		CGPUVertexLayout vertex_layout;
-		ECGPUPrimitiveTopology prim_topology;
-		CGPUBlendStateDescriptor blend_desc;
-		CGPUDepthStateDescriptor depth_desc;
-		CGPURasterizerStateDescriptor rasterizer_state;
-		CGPURenderPassId render_pass;
-		uint32_t subpass;
+		const RenderPass* render_pass;
+		uint32_t vertex_layout;
 		uint32_t render_target_count;
+		uint16_t blend_state;
+		uint16_t depth_state;
+		uint16_t rasterizer_state;
+		uint8_t prim_topology;
+		uint8_t subpass;
 	};
 
+	static_assert(std::has_unique_object_representations_v<PSOKey>, "PSOKey is hashed and compared bytewise, it must not have padding.");
+
 	struct PSOKeyHasher
 	{
 		inline size_t operator()(const PSOKey& key) const
 		{
-			size_t seed = 0;
-
-			hash_combine(seed, key.shader);
-			hash_combine(seed, key.vertex_layout);
-			hash_combine(seed, key.prim_topology);
-			hash_combine(seed, key.blend_desc);
-			hash_combine(seed, key.depth_desc);
-			hash_combine(seed, key.rasterizer_state);
-			hash_combine(seed, key.render_pass);
-			hash_combine(seed, key.subpass);
-			hash_combine(seed, key.render_target_count);
-
-			return seed;
+			return MurmurHashFn<PSOKey>()(key);
 		}
 	};
 
@@ -49,9 +52,33 @@ namespace HGEGraphics
 	{
 		inline bool operator()(const PSOKey& a, const PSOKey& b) const
 		{
-			return a.shader == b.shader && a.vertex_layout == b.vertex_layout && a.prim_topology == b.prim_topology 
-				&& a.blend_desc == b.blend_desc && a.rasterizer_state == b.rasterizer_state && a.render_pass == b.render_pass
-				&& a.subpass == b.subpass && a.render_target_count == b.render_target_count;
+			return !memcmp(&a, &b, sizeof(PSOKey));
+		}
+	};
+
+	// a prepared pipeline can wait for its first request longer than the render pass it was created with lives in its
+	// pool, so it is found by the descriptor of the render pass, which the render pass of the request has too
+	struct PreparedPSOKey
+	{
+		PSOKey key;
+		CGPURenderPassDescriptor render_pass;
+	};
+
+	struct PreparedPSOKeyHasher
+	{
+		inline size_t operator()(const PreparedPSOKey& key) const
+		{
+			size_t seed = PSOKeyHasher()(key.key);
+			hash_combine(seed, key.render_pass);
+			return seed;
+		}
+	};
+
+	struct PreparedPSOKeyEq
+	{
+		inline bool operator()(const PreparedPSOKey& a, const PreparedPSOKey& b) const
+		{
+			return PSOKeyEq()(a.key, b.key) && std::equal_to<CGPURenderPassDescriptor>()(a.render_pass, b.render_pass);
 		}
 	};
 
@@ -63,6 +90,8 @@ namespace HGEGraphics
 		}
 		CGPURenderPipelineId handle;
 		PSOKey _descriptor;
+		// false while the pipeline compiles asynchronously, handle is only valid once it is true
+		std::atomic<bool> ready{ true };
 	};
 
 	class GraphicsPipelinePool
@@ -72,7 +101,31 @@ namespace HGEGraphics
 		GraphicsPipelinePool(CGPUDeviceId device, GraphicsPipelinePool* upstream, std::pmr::memory_resource* const memory_resource);
 
 		GraphicsPipeline* getGraphicsPipeline(RenderPassEncoder* encoder, Shader* shader, Mesh* mesh);
-		GraphicsPipeline* getGraphicsPipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology prim_topology, const CGPUVertexLayout& vertex_layout);
+		GraphicsPipeline* getGraphicsPipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology prim_topology, uint32_t vertex_layout);
+		// the mutex guards this pool and its upstreams, it is only held for the lookups. a missing pipeline is created
+		// without it, unless it is compiled asynchronously anyway
+		GraphicsPipeline* getGraphicsPipeline(const PSOKey& key, std::mutex& mutex);
+		PSOKey pipelineKey(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology prim_topology, uint32_t vertex_layout) const;
+
+		// pipelines created are recorded in the cache, and in the manifest while there is one
+		void setPipelineCache(PipelineCache* cache) { pipeline_cache = cache; }
+		void setPipelineManifest(PipelineCache* manifest) { pipeline_manifest = manifest; }
+		// pipelines recorded by a pipeline cache can be created ahead of time, the first request for the key takes the
+		// prepared one instead of creating its own. createPipeline may run on any thread
+		PSOKey pipelineKey(Shader* shader, const GraphicsPipelineDescription& description, const RenderPass* render_pass) const;
+		bool isPrepared(const PSOKey& key) const { return prepared_pipelines.contains(preparedKey(key)) || hasResource(key); }
+		CGPURenderPipelineId createPipeline(const PSOKey& key) const;
+		void addPreparedPipeline(const PSOKey& key, CGPURenderPipelineId handle);
+		// prepared pipelines not requested for this many frames are freed
+		void setPreparedFramesBeforeOutOfDate(uint64_t frames) { prepared_frames_before_out_of_date = frames; }
+		size_t preparedCount() const { return prepared_pipelines.size(); }
+		void newFrame();
+		void destroy();
+		// with an executor, a missing pipeline is compiled by its workers and handed out before it is ready. the executor
+		// and the count belong to the creator, any pool of the chain can be asked
+		void setCompileExecutor(tf::Executor* executor) { creator()->compile_executor = executor; }
+		uint32_t compilingCount() const { return creator()->compiling_count.load(); }
+		bool compilesAsync() const { return creator()->compile_executor != nullptr; }
 
 		// 通过ResourcePool继承
 		virtual GraphicsPipeline* getResource_impl(const PSOKey& descriptor) override;
@@ -84,7 +137,26 @@ namespace HGEGraphics
 		bool dynamicStateT3Enabled() const { return dynamic_state_t3; }
 
 	private:
+		// the pool at the end of the upstreams, the only one creating pipelines
+		GraphicsPipelinePool* creator() { return m_upstream ? static_cast<GraphicsPipelinePool*>(m_upstream)->creator() : this; }
+		const GraphicsPipelinePool* creator() const { return m_upstream ? static_cast<const GraphicsPipelinePool*>(m_upstream)->creator() : this; }
+		static PreparedPSOKey preparedKey(const PSOKey& key);
+
+		struct PreparedPipeline
+		{
+			CGPURenderPipelineId handle;
+			uint64_t timestamp;
+		};
+
 		CGPUDeviceId device{ CGPU_NULLPTR };
+		PipelineCache* pipeline_cache{ nullptr };
+		PipelineCache* pipeline_manifest{ nullptr };
+		tf::Executor* compile_executor{ nullptr };
+		std::atomic<uint32_t> compiling_count{ 0 };
+		// prepared and not requested yet
+		std::pmr::unordered_map<PreparedPSOKey, PreparedPipeline, PreparedPSOKeyHasher, PreparedPSOKeyEq> prepared_pipelines;
+		// the first draw of a shader can be a long loading screen after the shader was loaded
+		uint64_t prepared_frames_before_out_of_date{ 3600 };
 		ECGPUDynamicStateFeaturesFlags _dynamic_state_features{ 0 };
 		bool dynamic_state_t1{ false };
 		bool dynamic_state_t2{ false };
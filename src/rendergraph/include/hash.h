@@ -25,6 +25,17 @@ namespace HGEGraphics
         return h;
     }
 
+    // stable across runs and platforms, for hashes that are written to disk
+    inline uint64_t fnv1a64(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull) noexcept {
+        const uint8_t* bytes = (const uint8_t*)data;
+        uint64_t h = seed;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= bytes[i];
+            h *= 0x100000001b3ull;
+        }
+        return h;
+    }
+
     template<typename T>
     struct MurmurHashFn {
         uint32_t operator()(const T& key) const noexcept {
@@ -50,75 +61,6 @@ namespace HGEGraphics
 }
 
 namespace std {
-	template <>
-	struct hash<CGPUVertexLayout> {
-		size_t operator()(const CGPUVertexLayout& a) const noexcept {
-			size_t seed = 0;
-
-			HGEGraphics::hash_combine(seed, a.attribute_count);
-			HGEGraphics::hash_combine(seed, a.p_attributes);
-
-			return seed;
-		}
-	};
-
-	template <>
-	struct hash<CGPUBlendStateDescriptor> {
-		size_t operator()(const CGPUBlendStateDescriptor& a) const noexcept {
-			size_t seed = 0;
-
-			HGEGraphics::hash_combine(seed, a.attachment_count);
-			HGEGraphics::hash_combine(seed, a.p_attachments);
-			HGEGraphics::hash_combine(seed, a.alpha_to_coverage);
-			HGEGraphics::hash_combine(seed, a.independent_blend);
-
-			return seed;
-		}
-	};
-
-	template <>
-	struct hash<CGPUDepthStateDescriptor> {
-		size_t operator()(const CGPUDepthStateDescriptor& a) const noexcept {
-			size_t seed = 0;
-
-			HGEGraphics::hash_combine(seed, a.depth_test);
-			HGEGraphics::hash_combine(seed, a.depth_write);
-			HGEGraphics::hash_combine(seed, a.depth_op);
-			HGEGraphics::hash_combine(seed, a.stencil_test);
-			HGEGraphics::hash_combine(seed, a.stencil_read_mask);
-			HGEGraphics::hash_combine(seed, a.stencil_write_mask);
-			HGEGraphics::hash_combine(seed, a.stencil_front_op);
-			HGEGraphics::hash_combine(seed, a.stencil_front_fail_op);
-			HGEGraphics::hash_combine(seed, a.depth_front_fail_op);
-			HGEGraphics::hash_combine(seed, a.stencil_front_pass_op);
-			HGEGraphics::hash_combine(seed, a.stencil_back_op);
-			HGEGraphics::hash_combine(seed, a.stencil_back_fail_op);
-			HGEGraphics::hash_combine(seed, a.depth_back_fail_op);
-			HGEGraphics::hash_combine(seed, a.stencil_back_pass_op);
-
-			return seed;
-		}
-	};
-
-	template <>
-	struct hash<CGPURasterizerStateDescriptor> {
-		size_t operator()(const CGPURasterizerStateDescriptor& a) const noexcept {
-			size_t seed = 0;
-
-			// ϸֶεĹϣֵ
-			HGEGraphics::hash_combine(seed, a.cull_mode);
-			HGEGraphics::hash_combine(seed, a.depth_bias);
-			HGEGraphics::hash_combine(seed, a.slope_scaled_depth_bias);
-			HGEGraphics::hash_combine(seed, a.fill_mode);
-			HGEGraphics::hash_combine(seed, a.front_face);
-			HGEGraphics::hash_combine(seed, a.enable_multi_sample);
-			HGEGraphics::hash_combine(seed, a.enable_scissor);
-			HGEGraphics::hash_combine(seed, a.enable_depth_clamp);
-
-			return seed;
-		}
-	};
-
 	template <>
 	struct hash<CGPUBufferDescriptor> {
 		size_t operator()(const CGPUBufferDescriptor& a) const noexcept {
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "cgpu/api.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+
+namespace HGEGraphics
+{
+	struct PSOKey;
+
+	// the adapter and driver a pipeline cache was written for, a cache written for any other one is dropped
+	struct PipelineCacheIdentity
+	{
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint32_t driver_version;
+	};
+
+	PipelineCacheIdentity pipeline_cache_identity(CGPUDeviceId device);
+
+	// a recorded graphics pipeline decoded back to the descriptors cgpu takes, the pointers point into the vectors
+	struct GraphicsPipelineDescription
+	{
+		GraphicsPipelineDescription(std::pmr::memory_resource* const memory_resource);
+
+		uint64_t shader_hash;
+		ECGPUPrimitiveTopology prim_topology;
+		CGPUVertexLayout vertex_layout;
+		std::pmr::vector<CGPUVertexAttribute> vertex_attributes;
+		CGPUBlendStateDescriptor blend_desc;
+		std::pmr::vector<CGPUBlendAttachmentState> blend_attachment_states;
+		CGPUDepthStateDescriptor depth_desc;
+		CGPURasterizerStateDescriptor rasterizer_state;
+		CGPURenderPassDescriptor render_pass;
+		uint32_t subpass;
+		uint32_t render_target_count;
+	};
+
+	// pipelines described by shader content and state values instead of handles and pointers. the cache of all pipelines
+	// created is written out when the program exits and read back at the next start, so the pipelines of a shader can be
+	// created as soon as the shader is loaded instead of at the first draw using them. a manifest records the pipelines of
+	// a stretch of play the same way, to be created together while loading
+	class PipelineCache
+	{
+	public:
+		PipelineCache(std::pmr::memory_resource* const memory_resource);
+
+		// records with equal bytes describe the same pipeline
+		static void encode(const PSOKey& key, std::pmr::string& record);
+		static bool decode(const std::pmr::string& record, GraphicsPipelineDescription& description);
+
+		void addGraphicsPipeline(const std::pmr::string& record);
+		void addComputePipeline(uint64_t shader_hash);
+		bool hasComputePipeline(uint64_t shader_hash) const;
+
+		// calls visitor(record) for every graphics pipeline recorded for the shader
+		template<typename Visitor>
+		void visitGraphicsPipelines(uint64_t shader_hash, Visitor&& visitor) const
+		{
+			for (auto& [record, idle_runs] : graphics_records)
+			{
+				if (recordShaderHash(record) == shader_hash)
+					visitor(record);
+			}
+		}
+
+		size_t graphicsPipelineCount() const { return graphics_records.size(); }
+		size_t computePipelineCount() const { return compute_shaders.size(); }
+
+		// a pipeline read back from a blob and not added again is kept for this many runs in a row, so a level not
+		// visited for a few sessions still starts warm
+		void setMaxIdleRuns(uint32_t runs) { max_idle_runs = runs; }
+
+		// the cache as a blob, tagged with the identity and the format version. pipelines not added for max_idle_runs
+		// runs in a row are dropped
+		void serialize(const PipelineCacheIdentity& identity, std::pmr::string& blob) const;
+		// adds the records of a blob, returns false and adds nothing when the blob is damaged or was written
+		// for another identity or format version
+		bool deserialize(const PipelineCacheIdentity& identity, const uint8_t* data, size_t size);
+
+	private:
+		static uint64_t recordShaderHash(const std::pmr::string& record);
+
+		// runs in a row the pipeline was not added in, 0 once it is added in this one
+		std::pmr::unordered_map<std::pmr::string, uint32_t> graphics_records;
+		std::pmr::unordered_map<uint64_t, uint32_t> compute_shaders;
+		uint32_t max_idle_runs{ 8 };
+	};
+}
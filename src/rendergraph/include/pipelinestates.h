@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cgpu/api.h"
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <memory_resource>
+
+namespace HGEGraphics
+{
+	// pipeline states interned by content. equal states get the same small id for the life of the process, so a
+	// pipeline key holds ids instead of descriptors and pointers. ids are never released, states are few and small
+	class PipelineStateRegistry
+	{
+	public:
+		PipelineStateRegistry(std::pmr::memory_resource* const memory_resource);
+
+		// id 0 is the layout without attributes
+		uint32_t internVertexLayout(const CGPUVertexLayout& vertex_layout);
+		uint16_t internBlendState(const CGPUBlendStateDescriptor& blend_desc);
+		uint16_t internDepthState(const CGPUDepthStateDescriptor& depth_desc);
+		uint16_t internRasterizerState(const CGPURasterizerStateDescriptor& rasterizer_state);
+
+		// the states stay where they are once interned, the pointers inside stay valid too
+		const CGPUVertexLayout& vertexLayout(uint32_t id) const;
+		const CGPUBlendStateDescriptor& blendState(uint16_t id) const;
+		const CGPUDepthStateDescriptor& depthState(uint16_t id) const;
+		const CGPURasterizerStateDescriptor& rasterizerState(uint16_t id) const;
+
+	private:
+		struct VertexLayoutEntry
+		{
+			CGPUVertexLayout vertex_layout;
+			std::pmr::vector<CGPUVertexAttribute> vertex_attributes;
+		};
+
+		struct BlendStateEntry
+		{
+			CGPUBlendStateDescriptor blend_desc;
+			std::pmr::vector<CGPUBlendAttachmentState> blend_attachment_states;
+		};
+
+		mutable std::mutex mutex;
+		std::pmr::memory_resource* memory_resource;
+		std::pmr::deque<VertexLayoutEntry> vertex_layouts;
+		std::pmr::deque<BlendStateEntry> blend_states;
+		std::pmr::deque<CGPUDepthStateDescriptor> depth_states;
+		std::pmr::deque<CGPURasterizerStateDescriptor> rasterizer_states;
+		// by the pipeline record encoding of the state
+		std::pmr::unordered_map<std::pmr::string, uint32_t> vertex_layout_ids;
+		std::pmr::unordered_map<std::pmr::string, uint16_t> blend_state_ids;
+		std::pmr::unordered_map<std::pmr::string, uint16_t> depth_state_ids;
+		std::pmr::unordered_map<std::pmr::string, uint16_t> rasterizer_state_ids;
+	};
+
+	PipelineStateRegistry& pipeline_state_registry();
+
+	// clears what tier 1 dynamic state sets while recording, pipelines then only differ by the rest
+	void strip_dynamic_states_t1(CGPUDepthStateDescriptor& depth_desc, CGPURasterizerStateDescriptor& rasterizer_state);
+}
@@ -16,6 +16,11 @@ namespace HGEGraphics
 		void CollectTimings();
 		void OnBeginFrame(CGPUCommandBufferId cmd);
 		void GetTimeStamp(CGPUCommandBufferId cmd, const char* label);
+		// split form for recording on several threads, indices are reserved in frame order first
+		void ClearTimeStamps();
+		uint32_t ReserveTimeStamp(const char* label);
+		void ResetQueries(CGPUCommandBufferId cmd);
+		void WriteTimeStamp(CGPUCommandBufferId cmd, uint32_t index);
 		void OnEndFrame(CGPUCommandBufferId cmd);
 		bool valid() { return labels.size() == durations.size() + 1; }
 		void Query(uint32_t& length, const char**& names, const float*& durations);
@@ -12,26 +12,72 @@
 #include "computepipelinepool.h"
 #include "textureviewpool.h"
 #include "bufferpool.h"
-#include "descriptorsetpool.h"
+#include "descriptorsetarena.h"
+#include "pipelinecache.h"
 #include <optional>
+#include <mutex>
+#include <atomic>
+#include <span>
 #include "profiler.h"
 #include "resource_type.h"
+#include "subresource_states.h"
 
 namespace HGEGraphics
 {
 	struct rendergraph_t;
 
+	// the bindings of a root signature that draws and dispatches fill from the global binding table, worked out once
+	// when the shader is created instead of walking the reflection at every draw
+	struct BindingPlan
+	{
+		struct Entry
+		{
+			uint32_t binding;
+			ECGPUResourceTypeFlags type;
+			// as reflected, the global binding table fills the first element
+			uint32_t array_count;
+		};
+
+		struct Set
+		{
+			uint32_t set_index;
+			// bit per binding of the set with an entry
+			uint64_t used;
+			uint32_t first_entry;
+			uint32_t entry_count;
+		};
+
+		std::vector<Set> sets;
+		std::vector<Entry> entries;
+	};
+
+	BindingPlan make_binding_plan(CGPURootSignatureId root_sig);
+
 	struct Shader
 	{
 		~Shader();
 
 		CGPURootSignatureId root_sig;
+		BindingPlan binding_plan;
 		CGPUShaderEntryDescriptor vs;
 		CGPUShaderEntryDescriptor ps;
 		CGPUBlendStateDescriptor blend_desc;
 		std::vector<CGPUBlendAttachmentState> blend_attachment_states;
 		CGPUDepthStateDescriptor depth_desc;
 		CGPURasterizerStateDescriptor rasterizer_state;
+		// the states above interned in the pipeline state registry, the dynamic ones without what tier 1 dynamic state sets
+		uint16_t blend_state_id;
+		uint16_t depth_state_id;
+		uint16_t rasterizer_state_id;
+		uint16_t dynamic_depth_state_id;
+		uint16_t dynamic_rasterizer_state_id;
+		// of the bytecode, names the shader in the pipeline cache
+		uint64_t content_hash;
+		// drawn with instead while a pipeline of this shader compiles asynchronously, must take the same vertex layout
+		// and bindings. without one those draws are skipped
+		Shader* fallback = nullptr;
+		// pipelines of this shader being compiled asynchronously
+		std::atomic<uint32_t> compiling_pipelines{ 0 };
 	};
 
 	std::unique_ptr<Shader> create_shader(CGPUDeviceId device, const uint8_t* vert_data, uint32_t vert_length, const uint8_t* frag_data, uint32_t frag_length, const CGPUBlendStateDescriptor& blend_desc, const CGPUDepthStateDescriptor& depth_desc, const CGPURasterizerStateDescriptor& rasterizer_state);
@@ -41,7 +87,9 @@ namespace HGEGraphics
 		~ComputeShader();
 
 		CGPURootSignatureId root_sig;
+		BindingPlan binding_plan;
 		CGPUShaderEntryDescriptor cs;
+		uint64_t content_hash;
 	};
 
 	std::unique_ptr<ComputeShader> create_compute_shader(CGPUDeviceId device, const uint8_t* comp_data, uint32_t comp_length);
@@ -62,6 +110,8 @@ namespace HGEGraphics
 	{
 		CGPUVertexLayout vertex_layout;
 		std::vector<CGPUVertexAttribute> vertex_attributes;
+		// vertex_layout interned in the pipeline state registry
+		uint32_t vertex_layout_id;
 		ECGPUPrimitiveTopology prim_topology;
 		uint32_t vertex_stride;
 		uint32_t index_stride;
@@ -86,8 +136,7 @@ namespace HGEGraphics
 
 		CGPUTextureId handle;
 		CGPUTextureViewId view;
-		std::vector<ECGPUResourceStateFlags> cur_states;
-		bool states_consistent;
+		SubresourceStates<ECGPUResourceStateFlags> cur_states;
 		bool prepared;
 		texture_handle_t dynamic_handle;
 	};
@@ -175,6 +224,101 @@ namespace HGEGraphics
 		uint64_t offset, size;
 	};
 
+	// what set_global_* bound for the pass being recorded, one slot per set and binding. a draw only looks again at the
+	// sets with slots changed since it last wrote their descriptor set
+	struct GlobalBindingTable
+	{
+		static constexpr uint32_t max_sets = 4;
+		static constexpr uint32_t max_bindings = 64;
+
+		ShaderTextureBinder textures[max_sets][max_bindings];
+		ShaderSamplerBinder samplers[max_sets][max_bindings];
+		ShaderBufferBinder buffers[max_sets][max_bindings];
+		// bit per binding holding something
+		uint64_t texture_mask[max_sets]{ 0 };
+		uint64_t sampler_mask[max_sets]{ 0 };
+		uint64_t buffer_mask[max_sets]{ 0 };
+		// bit per binding changed since the set was last written
+		uint64_t dirty[max_sets]{ 0 };
+
+		const ShaderTextureBinder* texture(uint32_t set, uint32_t bind) const { return bind < max_bindings && (texture_mask[set] & (1ull << bind)) ? &textures[set][bind] : nullptr; }
+		const ShaderSamplerBinder* sampler(uint32_t set, uint32_t bind) const { return bind < max_bindings && (sampler_mask[set] & (1ull << bind)) ? &samplers[set][bind] : nullptr; }
+		const ShaderBufferBinder* buffer(uint32_t set, uint32_t bind) const { return bind < max_bindings && (buffer_mask[set] & (1ull << bind)) ? &buffers[set][bind] : nullptr; }
+
+		void setTexture(const ShaderTextureBinder& binder);
+		void setSampler(const ShaderSamplerBinder& binder);
+		void setBuffer(const ShaderBufferBinder& binder);
+		void clear();
+	};
+
+	// command buffers recorded by the executor for one queue submission, in submission order
+	struct SubmitBatch
+	{
+		ECGPUQueueType queue;
+		uint32_t first_cmd;
+		uint32_t cmd_count;
+		CGPUSemaphoreId wait_semaphore;
+		CGPUSemaphoreId signal_semaphore;
+	};
+
+	// command pools, descriptor sets and binding tables of one recording thread
+	struct CommandRecorder
+	{
+		CGPUCommandPoolId cmdPool = { CGPU_NULLPTR };
+		std::pmr::vector<CGPUCommandBufferId> cmds;
+		std::pmr::vector<CGPUCommandBufferId> allocated_cmds;
+		CGPUCommandPoolId computeCmdPool = { CGPU_NULLPTR };
+		std::pmr::vector<CGPUCommandBufferId> compute_cmds;
+		std::pmr::vector<CGPUCommandBufferId> allocated_compute_cmds;
+		GlobalBindingTable global_bindings;
+		DescriptorSetArenas descriptorSets;
+		// pipelines this recorder looked up during the frame, found again without taking the pipeline mutex. a pipeline
+		// looked up in the frame can't expire before the frame ends
+		std::pmr::unordered_map<PSOKey, GraphicsPipeline*, PSOKeyHasher, PSOKeyEq> graphics_pipelines;
+		std::pmr::unordered_map<ComputeShader*, ComputePipeline*> compute_pipelines;
+
+		CommandRecorder(CGPUQueueId gfx_queue, CGPUQueueId compute_queue, std::pmr::memory_resource* memory_resource);
+
+		void newFrame();
+
+		CGPUCommandBufferId requestCmd(ECGPUQueueType queue = CGPU_QUEUE_TYPE_GRAPHICS);
+		void clearBindings();
+
+		void destroy();
+	};
+
+	// pools shared by every frame in flight. a frame hands back the transient textures and buffers it released once its fence
+	// has signaled, pipelines and render passes are created once for all frames
+	struct SharedResourcePools
+	{
+		std::pmr::memory_resource* memory_resource = nullptr;
+		CgpuTexturePool texturePool;
+		BufferPool bufferPool;
+		RenerPassPool renderPassPool;
+		GraphicsPipelinePool pipelinePool;
+		ComputePipelinePool computePipelinePool;
+		// every pipeline the pools above created, plus what was loaded into it
+		PipelineCache pipelineCache;
+		// guards the pipeline and render pass pools and the pipeline cache, any recording thread of any frame may look them up
+		std::mutex pipeline_mutex;
+		// textures and buffers of the pools above together, over its limit the least recently used idle ones are evicted
+		// at newFrame whichever pool they are in
+		ResourceBudget transientBudget;
+
+		SharedResourcePools(CGPUDeviceId device, CGPUQueueId gfx_queue, uint32_t frames_in_flight, std::pmr::memory_resource* memory_resource);
+
+		// creates ahead of time the pipelines the records hold for the shaders, spread over the executor's workers when
+		// there is one, and returns once all are created
+		void preparePipelines(const PipelineCache& records, std::span<Shader* const> shaders, tf::Executor* executor = nullptr);
+		void preparePipelines(const PipelineCache& records, std::span<ComputeShader* const> shaders);
+		// the pipelines of the pipeline cache, right after the shader is created
+		void preparePipelines(Shader* shader);
+		void preparePipelines(ComputeShader* shader);
+
+		void newFrame();
+		void destroy();
+	};
+
 	struct ExecutorContext
 	{
 		std::pmr::memory_resource* memory_resource = nullptr;
@@ -185,14 +329,17 @@ namespace HGEGraphics
 		ComputePipelinePool computePipelinePool;
 		TextureViewPool textureViewPool;
 		BufferPool bufferPool;
-		CGPUCommandPoolId cmdPool = { CGPU_NULLPTR };
-		std::pmr::vector<CGPUCommandBufferId> cmds;
-		std::pmr::vector<CGPUCommandBufferId> allocated_cmds;
-		std::pmr::vector<ShaderTextureBinder> global_texture_table;
-		std::pmr::vector<ShaderSamplerBinder> global_sampler_table;
-		std::pmr::vector<ShaderBufferBinder> global_buffer_table;
-		DescriptorSetPool descriptorSetPool;
-		std::pmr::vector<DescriptorSet*> allocated_dsets;
+		// guards the pools above while passes are recorded in parallel
+		std::unique_ptr<std::mutex> pool_mutex;
+		// guards the pipeline and render pass pools, the one of the shared pools when they are upstream
+		std::mutex* pipeline_mutex = nullptr;
+		CGPUQueueId gfx_queue = { CGPU_NULLPTR };
+		CGPUQueueId compute_queue = { CGPU_NULLPTR };
+		std::pmr::vector<CommandRecorder*> recorders;
+		std::pmr::vector<CGPUSemaphoreId> semaphores;
+		size_t used_semaphore_count = 0;
+		std::pmr::vector<CGPUCommandBufferId> submit_cmds;
+		std::pmr::vector<SubmitBatch> submit_batches;
 		CGPUDeviceId device = { CGPU_NULLPTR };
 		uint64_t timestamp = { 0 };
 		Profiler* profiler = nullptr;
@@ -200,16 +347,42 @@ namespace HGEGraphics
 		CGPUTextureViewId default_texture = CGPU_NULLPTR;
 		bool support_shading_rate;
 
-		ExecutorContext(CGPUDeviceId device, CGPUQueueId gfx_queue, bool profile, std::pmr::memory_resource* memory_resource);
+		ExecutorContext(CGPUDeviceId device, CGPUQueueId gfx_queue, bool profile, std::pmr::memory_resource* memory_resource, CGPUQueueId compute_queue = CGPU_NULLPTR, SharedResourcePools* shared_pools = nullptr);
 
+		// the work submitted with this context must be finished
 		void newFrame();
+		// same requirement, returns the transient resources released by the last frame to the shared pools
+		void recycleTransientResources();
+		// destroys the views of the texture and the framebuffers of those views, the texture is about to be destroyed
+		void forgetTexture(CGPUTextureId texture);
 
-		CGPUCommandBufferId requestCmd();
+		CommandRecorder* requestRecorder(size_t index);
+		CGPUSemaphoreId requestSemaphore();
+		// the descriptor set arenas of all recorders together
+		DescriptorSetArenaStats descriptorSetStats() const;
 
 		void destroy();
 		void pre_destroy();
 	};
 
+	// the descriptor sets an encoder bound for the root signature of its pipeline, with what the bindings of each set
+	// resolved to when it was written. switching to another root signature forgets them all
+	struct DescriptorSetTracker
+	{
+		static constexpr uint32_t max_sets = GlobalBindingTable::max_sets;
+		static constexpr uint32_t inline_words = 24;
+
+		CGPURootSignatureId root_signature = CGPU_NULLPTR;
+		uint8_t bound_sets = 0;
+		uint8_t word_counts[max_sets];
+		uint64_t words[max_sets][inline_words];
+
+		bool bound(uint32_t set) const { return bound_sets & (1u << set); }
+		void reset(CGPURootSignatureId root_signature) { this->root_signature = root_signature; bound_sets = 0; }
+		// whether the bound set holds these, otherwise they are what it holds once written
+		bool matches(uint32_t set, const uint64_t* set_words, uint32_t count);
+	};
+
 	struct CompiledRenderGraph;
 	struct RenderPassEncoder
 	{
@@ -218,18 +391,15 @@ namespace HGEGraphics
 		CGPUStateBufferId state_buffer;
 		CGPURasterStateEncoderId raster_state_encoder;
 		CGPURenderPassId render_pass;
+		const RenderPass* render_pass_resource;
 		uint32_t subpass;
 		uint32_t render_target_count;
 		ExecutorContext* context;
+		CommandRecorder* recorder;
 		CompiledRenderGraph* compiled_graph;
 		CGPURenderPipelineId last_render_pipeline;
 		CGPUComputePipelineId last_compute_pipeline;
-		CGPUDescriptorData last_bind_resources[4][64]{ 0 };
-		uint64_t last_buffer_offset_sizes[4][128]{ 0 };
-		CGPUTextureViewId textureviews[64]{ 0 };
-		CGPUSamplerId samplers[64]{ 0 };
-		CGPUBufferId buffers[64]{ 0 };
-		uint64_t buffer_offset_sizes[128]{ 0 };
+		DescriptorSetTracker descriptor_sets;
 		CGPUBufferId last_vertex_buffer;
 		CGPUBufferId last_index_buffer;
 		uint32_t last_vertex_buffer_stride;
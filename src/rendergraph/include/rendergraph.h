@@ -91,6 +91,8 @@ namespace HGEGraphics
 		uint8_t mipLevel;
 		uint8_t arraySlice;
 		ECGPUResourceTypeFlags bufferType;
+		// cube and rw texture usage of a managed texture
+		ECGPUResourceTypeFlags textureType;
 		ECGPUMemoryUsage memoryUsage;
 		bool holdOnLast;
 	};
@@ -138,6 +140,7 @@ namespace HGEGraphics
 		struct compute_context_t
 		{
 			renderpass_executable executable;
+			ECGPUQueueType queue;
 		};
 
 		struct present_context_t
@@ -203,6 +206,10 @@ namespace HGEGraphics
 	void rg_texture_set_extent(rendergraph_t* self, texture_handle_t texture, uint32_t width, uint32_t height, uint32_t depth = 1);
 	void rg_texture_set_format(rendergraph_t* self, texture_handle_t texture, ECGPUTextureFormat format);
 	void rg_texture_set_depth_format(rendergraph_t* self, texture_handle_t texture, DepthBits depthBits, bool needStencil);
+	void rg_texture_set_mip_count(rendergraph_t* self, texture_handle_t texture, uint32_t mipCount);
+	void rg_texture_set_array_size(rendergraph_t* self, texture_handle_t texture, uint32_t arraySize);
+	// six layers a cube, sampled as a cube when the whole texture is
+	void rg_texture_set_cube(rendergraph_t* self, texture_handle_t texture, uint32_t cubeCount = 1);
 	uint32_t rg_texture_get_width(rendergraph_t* self, texture_handle_t texture);
 	uint32_t rg_texture_get_height(rendergraph_t* self, texture_handle_t texture);
 	uint32_t rg_texture_get_depth(rendergraph_t* self, texture_handle_t texture);
@@ -238,7 +245,7 @@ namespace HGEGraphics
 		return handle.index != 0;
 	}
 	renderpass_builder_t rendergraph_add_renderpass(rendergraph_t* self, const char* name);
-	renderpass_builder_t rendergraph_add_computepass(rendergraph_t* self, const char* name);
+	renderpass_builder_t rendergraph_add_computepass(rendergraph_t* self, const char* name, ECGPUQueueType queue = CGPU_QUEUE_TYPE_GRAPHICS);
 	renderpass_builder_t rendergraph_add_holdpass(rendergraph_t* self, const char* name);
 	void rendergraph_add_uploadtexturepass(rendergraph_t* self, const char* name, texture_handle_t texture, uint8_t mipmap, uint8_t slice, uploadpass_executable executable, size_t passdata_size, void** passdata);
 	void rendergraph_add_uploadtexturepass_ex(rendergraph_t* self, const char* name, texture_handle_t texture, uint8_t mipmap, uint8_t slice, uint64_t size, uint64_t offset, void* data, uploadpass_executable executable, size_t passdata_size, void** passdata);
@@ -257,5 +264,5 @@ namespace HGEGraphics
 	uint32_t rendergraph_add_edge(rendergraph_t* self, index_type_t from, index_type_t to, ECGPUResourceStateFlags usage);
 
 	CGPUBufferId rendergraph_resolve_buffer(RenderPassEncoder* encoder, buffer_handle_t buffer_handle);
-	CGPUTextureViewId rendergraph_resolve_texture_view(RenderPassEncoder* encoder, texture_handle_t texture_handle);
+	CGPUTextureViewId rendergraph_resolve_texture_view(RenderPassEncoder* encoder, texture_handle_t texture_handle, ECGPUTextureViewUsageFlags usage = CGPU_TEXTURE_VIEW_USAGE_SRV);
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "rendergraph.h"
+#include <unordered_map>
+#include <span>
 
 namespace HGEGraphics
 {
@@ -9,7 +11,7 @@ namespace HGEGraphics
 
 	struct CompiledResourceNode
 	{
-		CompiledResourceNode(const char* name, ManageType type, uint16_t width, uint16_t height, uint16_t depth, ECGPUTextureFormat format, Texture* texture, uint8_t mipCount, uint8_t arraySize, index_type_t parent, uint8_t mipLevel, uint8_t arraySlice);
+		CompiledResourceNode(const char* name, ManageType type, uint16_t width, uint16_t height, uint16_t depth, ECGPUTextureFormat format, Texture* texture, uint8_t mipCount, uint8_t arraySize, ECGPUResourceTypeFlags textureType, index_type_t parent, uint8_t mipLevel, uint8_t arraySlice);
 		CompiledResourceNode(const char* name, ManageType type, uint32_t size, Buffer* imported_buffer, ECGPUResourceTypeFlags bufferType, ECGPUMemoryUsage memoryUsage);
 		CompiledResourceNode();
 
@@ -26,12 +28,85 @@ namespace HGEGraphics
 		BufferWrap* managed_buffer;
 		const uint32_t size;
 		const ECGPUResourceTypeFlags bufferType;
+		const ECGPUResourceTypeFlags textureType;
 		const ECGPUMemoryUsage memoryUsage;
 		uint8_t mipCount;;
 		uint8_t arraySize;
 		index_type_t parent;
 		uint8_t mipLevel;
 		uint8_t arraySlice;
+		index_type_t alias_slot{ MAX_INDEX };
+	};
+
+	// backing allocation shared by transient resources whose lifetimes don't overlap
+	struct TransientSlot
+	{
+		ResourceType resourceType;
+		index_type_t first_resource;
+		index_type_t last_resource;
+		index_type_t last_pass;
+		ECGPUQueueType queue;
+		uint64_t size;
+		TextureWrap* texture{ nullptr };
+		BufferWrap* buffer{ nullptr };
+	};
+
+	struct TransientLifetime
+	{
+		index_type_t resource;
+		index_type_t first;
+		index_type_t last;
+		ECGPUQueueType queue;
+		// resources used on both queues keep their own memory
+		bool single_queue;
+	};
+
+	struct TransientMemoryReport
+	{
+		uint32_t resource_count{ 0 };
+		uint32_t slot_count{ 0 };
+		// what the pools would allocate by reusing released resources with identical descriptors
+		uint64_t requested_bytes{ 0 };
+		// transient resources alive at the busiest pass
+		uint64_t peak_bytes{ 0 };
+		// what the aliasing slots actually allocate
+		uint64_t aliased_bytes{ 0 };
+	};
+
+	// attachment loads and stores the compiler proved unnecessary for managed resources
+	struct AttachmentTrafficReport
+	{
+		uint32_t loads_skipped{ 0 };
+		uint32_t stores_skipped{ 0 };
+		uint64_t load_bytes_saved{ 0 };
+		uint64_t store_bytes_saved{ 0 };
+	};
+
+	// a transition worked out by the compiler and replayed by the executor, resource is always the root resource
+	struct CompiledBarrier
+	{
+		index_type_t resource;
+		ECGPUResourceStateFlags src_state;
+		ECGPUResourceStateFlags dst_state;
+		// last pass touching the resource before, a split barrier could begin right after it. MAX_INDEX if there is none
+		index_type_t begin_pass;
+		// subresources numbered mip first, then array layer
+		uint32_t first_subresource;
+		uint32_t subresource_count;
+		// first use in the frame, src_state is whatever the resource holds when the frame executes
+		bool resolve_src;
+		// emit even if the resolved state already matches
+		bool force;
+	};
+
+	struct BarrierReport
+	{
+		uint32_t planned_barriers{ 0 };
+		// planned barriers with passes between producer and consumer that a split barrier could overlap
+		uint32_t split_candidates{ 0 };
+		// what the executor actually recorded for the last frame, queue ownership transfers included
+		uint32_t recorded_barriers{ 0 };
+		uint32_t barrier_calls{ 0 };
 	};
 
 	struct CompiledEdge
@@ -42,15 +117,22 @@ namespace HGEGraphics
 
 	struct CompiledRenderPassNode
 	{
-		CompiledRenderPassNode(const char* name, std::pmr::memory_resource* const memory_resource);
+		CompiledRenderPassNode(const char* name);
 		CompiledRenderPassNode();
 
 		const char* name{ nullptr };
 		pass_type type;
-		std::pmr::vector<CompiledEdge> writes;
-		std::pmr::vector<CompiledEdge> reads;
-		std::pmr::vector<index_type_t> devirtualize;
-		std::pmr::vector<index_type_t> destroy;
+		index_type_t pass_index;
+		ECGPUQueueType queue{ CGPU_QUEUE_TYPE_GRAPHICS };
+		// ranges of CompiledRenderGraph::edges, the reads come first
+		uint32_t first_edge{ 0 };
+		uint32_t read_count{ 0 };
+		uint32_t write_count{ 0 };
+		// ranges of CompiledRenderGraph::lifetime_resources
+		uint32_t first_devirtualize{ 0 };
+		uint32_t devirtualize_count{ 0 };
+		uint32_t first_destroy{ 0 };
+		uint32_t destroy_count{ 0 };
 		void* passdata;
 		int colorAttachmentCount{ 0 };
 		std::array<ColorAttachmentInfo, 8> colorAttachments;
@@ -64,6 +146,42 @@ namespace HGEGraphics
 		void* data;
 		uint8_t mipmap;
 		uint8_t slice;
+		// consecutive render passes drawing to the same attachments share one render pass instance
+		bool merge_with_previous{ false };
+		bool merge_with_next{ false };
+		// the head of a merged chain carries the barriers of the whole chain
+		uint32_t first_barrier{ 0 };
+		uint32_t barrier_count{ 0 };
+	};
+
+	// a resource whose content moves between queue families, queue is the one on the other side
+	struct QueueTransfer
+	{
+		index_type_t resource;
+		ECGPUQueueType queue;
+	};
+
+	// consecutive passes recorded into one command buffer and submitted to one queue
+	struct CompiledBatch
+	{
+		CompiledBatch(ECGPUQueueType queue, index_type_t first_pass, std::pmr::memory_resource* const memory_resource);
+
+		ECGPUQueueType queue;
+		index_type_t first_pass;
+		index_type_t end_pass;
+		// batch on the other queue to wait for, MAX_INDEX if none
+		index_type_t wait_batch{ MAX_INDEX };
+		bool signal{ false };
+		std::pmr::vector<QueueTransfer> acquires;
+		std::pmr::vector<QueueTransfer> releases;
+	};
+
+	enum class PassSchedule
+	{
+		// passes run in declaration order
+		Declaration,
+		// reorder independent passes to batch identical resource states and move consumers away from their producers
+		MinimizeBarriers,
 	};
 
 	struct CompiledRenderGraph
@@ -71,10 +189,88 @@ namespace HGEGraphics
 		CompiledRenderGraph(std::pmr::memory_resource* const memory_resource);
 		std::pmr::vector<CompiledResourceNode> resources;
 		std::pmr::vector<CompiledRenderPassNode> passes;
+		std::pmr::vector<CompiledEdge> edges;
+		// managed resources created and released by each pass
+		std::pmr::vector<index_type_t> lifetime_resources;
+		std::pmr::vector<TransientSlot> transient_slots;
+		std::pmr::vector<CompiledBatch> batches;
+		std::pmr::vector<CompiledBarrier> barriers;
+		TransientMemoryReport transient_memory;
+		AttachmentTrafficReport attachment_traffic;
+		BarrierReport barrier_report;
+		uint64_t topology_hash{ 0 };
+		uint32_t merged_pass_count{ 0 };
+		PassSchedule schedule{ PassSchedule::Declaration };
+		bool async_compute{ false };
+
+		std::span<const CompiledEdge> reads(const CompiledRenderPassNode& pass) const { return { edges.data() + pass.first_edge, pass.read_count }; }
+		std::span<const CompiledEdge> writes(const CompiledRenderPassNode& pass) const { return { edges.data() + pass.first_edge + pass.read_count, pass.write_count }; }
+		std::span<const index_type_t> devirtualized(const CompiledRenderPassNode& pass) const { return { lifetime_resources.data() + pass.first_devirtualize, pass.devirtualize_count }; }
+		std::span<const index_type_t> destroyed(const CompiledRenderPassNode& pass) const { return { lifetime_resources.data() + pass.first_destroy, pass.destroy_count }; }
+	};
+
+	// scratch arrays of Compile, a caller compiling repeatedly keeps one around so their capacity is reused.
+	// nodes are the passes followed by the resources, their edges are stored as compressed rows
+	struct CompilerWorkspace
+	{
+		CompilerWorkspace(std::pmr::memory_resource* const memory_resource);
+
+		std::pmr::vector<uint32_t> in_offsets;
+		std::pmr::vector<uint32_t> out_offsets;
+		std::pmr::vector<index_type_t> ins;
+		std::pmr::vector<index_type_t> outs;
+		std::pmr::vector<uint32_t> ref_counts;
+		std::pmr::vector<index_type_t> culling_stack;
+		std::pmr::vector<index_type_t> order;
+		std::pmr::vector<index_type_t> position;
+		std::pmr::vector<TransientLifetime> lifetimes;
+		std::pmr::vector<uint32_t> lifetime_offsets;
 	};
 
 	struct Compiler
 	{
-		static CompiledRenderGraph Compile(const rendergraph_t& renderGraph, std::pmr::memory_resource* const memory_resource);
+		// without async_compute every pass goes to the graphics queue regardless of its hint
+		static CompiledRenderGraph Compile(const rendergraph_t& renderGraph, std::pmr::memory_resource* const memory_resource, PassSchedule schedule = PassSchedule::Declaration, bool async_compute = false, CompilerWorkspace* workspace = nullptr);
+		// everything Compile depends on written out word by word, per-frame data like pass data, executables, clear values and
+		// imported handles is excluded
+		static void TopologyKey(const rendergraph_t& renderGraph, std::pmr::vector<uint64_t>& key);
+		// hash of the topology key
+		static uint64_t TopologyHash(const rendergraph_t& renderGraph);
+		// refresh the per-frame data of a graph compiled from a rendergraph with the same topology hash
+		static void Patch(CompiledRenderGraph& compiled, const rendergraph_t& renderGraph);
+	};
+
+	class CompiledRenderGraphCache
+	{
+	public:
+		CompiledRenderGraphCache(uint64_t frame_before_out_of_date, std::pmr::memory_resource* const memory_resource);
+
+		CompiledRenderGraph& compile(const rendergraph_t& renderGraph);
+		void newFrame();
+		void destroy();
+
+		PassSchedule schedule{ PassSchedule::Declaration };
+		bool async_compute{ false };
+
+		uint64_t hits() const { return hit_count; }
+		uint64_t misses() const { return miss_count; }
+
+	private:
+		struct Entry
+		{
+			CompiledRenderGraph* compiled;
+			// compared on a hit, the hash alone can collide
+			std::pmr::vector<uint64_t> key;
+			uint64_t timestamp;
+		};
+
+		std::pmr::memory_resource* memory_resource;
+		std::pmr::unordered_map<uint64_t, Entry> entries;
+		std::pmr::vector<uint64_t> key;
+		CompilerWorkspace workspace;
+		uint64_t timestamp{ 0 };
+		uint64_t frame_before_out_of_date;
+		uint64_t hit_count{ 0 };
+		uint64_t miss_count{ 0 };
 	};
 }
\ No newline at end of file
@@ -3,10 +3,16 @@
 #include "rendergraph_compiler.h"
 #include "renderer.h"
 
+namespace tf
+{
+	class Executor;
+}
+
 namespace HGEGraphics
 {
 	struct Executor
 	{
-		static void Execute(CompiledRenderGraph& compiledRenderGraph, ExecutorContext& texturepool);
+		// with a task executor the passes are recorded in parallel chunks, each into its own command buffer
+		static void Execute(CompiledRenderGraph& compiledRenderGraph, ExecutorContext& texturepool, tf::Executor* taskExecutor = nullptr);
 	};
 }
\ No newline at end of file
@@ -23,7 +23,7 @@ namespace HGEGraphics
 		: public ResourcePool<CGPURenderPassDescriptor, RenderPass, true, true>
 	{
 	public:
-		RenerPassPool(CGPUDeviceId device, std::pmr::memory_resource* const memory_resource);
+		RenerPassPool(CGPUDeviceId device, RenerPassPool* upstream, std::pmr::memory_resource* const memory_resource);
 
 		RenderPass* getRenderPass(const CGPURenderPassDescriptor& descriptor);
 
@@ -1,40 +1,100 @@
 #pragma once
 
-#include <unordered_map>
+#include <vector>
+#include <bit>
+#include <stdint.h>
 #include <memory_resource>
+#include <chrono>
+#include <algorithm>
 
 namespace HGEGraphics
 {
+	struct ResourcePoolStats
+	{
+		// created by this pool and not destroyed yet, whoever holds them
+		uint32_t resident_count{ 0 };
+		uint64_t resident_bytes{ 0 };
+		uint64_t peak_resident_bytes{ 0 };
+		// resident bytes idle resources are evicted down to, 0 is unlimited
+		uint64_t budget_bytes{ 0 };
+		// waiting in this pool to be handed out again
+		uint32_t idle_count{ 0 };
+		uint64_t idle_bytes{ 0 };
+		// requests served from this pool and requests that had to create a resource
+		uint64_t hits{ 0 };
+		uint64_t misses{ 0 };
+		// idle resources destroyed or handed upstream for not being used in time
+		uint64_t evictions{ 0 };
+		// idle resources destroyed or handed upstream to get back under a budget
+		uint64_t budget_evictions{ 0 };
+		uint64_t create_time_ns{ 0 };
+		uint64_t max_create_time_ns{ 0 };
+	};
+
+	// resident bytes of several pools together, e.g. all transient memory of a device
+	struct ResourceBudget
+	{
+		// 0 is unlimited
+		uint64_t limit_bytes{ 0 };
+		uint64_t current_bytes{ 0 };
+		uint64_t peak_bytes{ 0 };
+	};
+
 	template<typename ResourceDescriptor, typename ResourceType, bool neverRelease, bool destroyOutOfDate, class ResourceDescriptorHasher = std::hash<ResourceDescriptor>, class ResourceDescriptorEq = std::equal_to<ResourceDescriptor>>
 	class ResourcePool
 	{
 		using ThisType = ResourcePool<ResourceDescriptor, ResourceType, neverRelease, destroyOutOfDate, ResourceDescriptorHasher, ResourceDescriptorEq>;
-		using MapType = std::pmr::unordered_multimap<ResourceDescriptor, std::pair<ResourceType*, uint64_t>, ResourceDescriptorHasher, ResourceDescriptorEq>;
+		static constexpr uint32_t invalid_index = ~0u;
+
+		// a descriptor with idle resources, found through an open addressing table of record indices
+		struct KeyRecord
+		{
+			ResourceDescriptor descriptor;
+			size_t hash;
+			// newest idle entry of the descriptor, or the next free record
+			uint32_t head;
+		};
+
+		// an idle resource, in the list of its descriptor and in the expiry list, which is ordered by timestamp
+		struct Entry
+		{
+			ResourceType* resource;
+			uint64_t timestamp;
+			uint32_t key;
+			uint32_t prev_same;
+			uint32_t next_same;
+			uint32_t prev_expiry;
+			uint32_t next_expiry;
+		};
 
 	public:
 		ResourcePool() = default;
 		ResourcePool(uint64_t frame_before_out_of_data, ThisType* upstream, std::pmr::memory_resource* const memory_resource)
-			: m_upstream(upstream), m_resources(memory_resource), frame_before_out_of_data(frame_before_out_of_data)
+			: m_upstream(upstream), frame_before_out_of_data(frame_before_out_of_data), m_buckets(memory_resource), m_keys(memory_resource), m_entries(memory_resource)
 		{
 		}
 
 		void destroy()
 		{
-			if (m_upstream)
-			{
-				for (auto& [key, resource] : m_resources)
-				{
-					m_upstream->releaseResource(resource.first);
-				}
-			}
-			else
+			for (auto index = expiry_head; index != invalid_index; index = m_entries[index].next_expiry)
 			{
-				for (auto& [key, resource] : m_resources)
-				{
-					destroyResource_impl(resource.first);
-				}
+				auto& entry = m_entries[index];
+				if (m_upstream)
+					m_upstream->releaseResource(entry.resource);
+				else
+					destroyResource(m_keys[entry.key].descriptor, entry.resource);
 			}
-			m_resources.clear();
+			clearEntries();
+		}
+
+		// hand the idle resources to the upstream pool, where any user of the upstream can pick them up
+		void recycle()
+		{
+			if (!m_upstream)
+				return;
+			for (auto index = expiry_head; index != invalid_index; index = m_entries[index].next_expiry)
+				m_upstream->releaseResource(m_entries[index].resource);
+			clearEntries();
 		}
 
 		virtual ~ResourcePool()
@@ -47,30 +107,36 @@ namespace HGEGraphics
 
 			if constexpr (destroyOutOfDate)
 			{
-				std::erase_if(m_resources, [this](auto& kv) -> bool 
+				// the oldest entries are at the head, only the expired ones are visited
+				while (expiry_head != invalid_index && timestamp > m_entries[expiry_head].timestamp + frame_before_out_of_data)
 				{
-					bool out_of_date = timestamp > kv.second.second + frame_before_out_of_data;
-					if (out_of_date)
-					{
-						destroyResource_impl(kv.second.first);
-					}
-					return out_of_date;
-				});
+					evictOldest();
+					eviction_count++;
+				}
+			}
+
+			while (budget_bytes && resident_bytes > budget_bytes)
+			{
+				if (!evictForBudget())
+					break;
 			}
 		}
 
 		ResourceType* getResource(const ResourceDescriptor& descriptor)
 		{
-			auto iter = m_resources.find(descriptor);
-			if (iter != m_resources.end())
+			auto key = findKey(descriptor, ResourceDescriptorHasher()(descriptor));
+			if (key != invalid_index)
 			{
-				auto& resourceNode = iter->second;
-				auto resource = resourceNode.first;
+				auto index = m_keys[key].head;
+				auto resource = m_entries[index].resource;
+				hit_count++;
 				if constexpr (!neverRelease)
-					m_resources.erase(iter);
+					removeEntry(index);
 				else
 				{
-					resourceNode.second = timestamp;
+					m_entries[index].timestamp = timestamp;
+					unlinkExpiry(index);
+					linkExpiry(index);
 				}
 				return resource;
 			}
@@ -79,28 +145,352 @@ namespace HGEGraphics
 				return m_upstream->getResource(descriptor);
 			else
 			{
+				auto start = std::chrono::steady_clock::now();
 				auto res = getResource_impl(descriptor);
+				uint64_t create_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+				miss_count++;
+				create_time_ns += create_time;
+				max_create_time_ns = std::max(max_create_time_ns, create_time);
+				resident_count++;
+				addResidentBytes(resourceSize(descriptor));
 				if constexpr (neverRelease)
-					m_resources.insert({ descriptor, {res, timestamp} });
+					addEntry(descriptor, res);
 				return res;
 			}
 		}
 		void releaseResource(ResourceType* resource)
 		{
 			if constexpr (!neverRelease)
-				m_resources.insert({ resource->descriptor(), {resource, timestamp} });
+				addEntry(resource->descriptor(), resource);
 		}
 
 		ThisType* upstream() const { return m_upstream; }
+		void setFramesBeforeOutOfDate(uint64_t frames) { frame_before_out_of_data = frames; }
+
+		ResourcePoolStats stats() const
+		{
+			ResourcePoolStats stats;
+			stats.resident_count = resident_count;
+			stats.resident_bytes = resident_bytes;
+			stats.peak_resident_bytes = peak_resident_bytes;
+			stats.budget_bytes = budget_bytes;
+			stats.idle_count = idle_count;
+			stats.idle_bytes = idle_bytes;
+			stats.hits = hit_count;
+			stats.misses = miss_count;
+			stats.evictions = eviction_count;
+			stats.budget_evictions = budget_eviction_count;
+			stats.create_time_ns = create_time_ns;
+			stats.max_create_time_ns = max_create_time_ns;
+			return stats;
+		}
+
+		// at every newFrame, idle resources are evicted least recently used first until the resident bytes are within
+		// the budget. resources in use are never evicted, and only a pool without upstream creates and so holds any.
+		// newFrame must only be called once the gpu is done with the idle resources, as it always had to
+		void setBudget(uint64_t bytes) { budget_bytes = bytes; }
+		// the resident bytes are added to the shared budget too, the owner of the budget enforces it
+		void setSharedBudget(ResourceBudget* budget) { shared_budget = budget; }
+
+		// timestamp of the least recently used idle resource, UINT64_MAX when there is none
+		uint64_t oldestIdleTimestamp() const
+		{
+			return expiry_head != invalid_index ? m_entries[expiry_head].timestamp : UINT64_MAX;
+		}
+
+		// evicts the least recently used idle resource, false when there is none
+		bool evictForBudget()
+		{
+			if (!evictOldest())
+				return false;
+			budget_eviction_count++;
+			return true;
+		}
+
+		// evicts the idle resources the predicate picks whatever their age, the ones left useless by a resource
+		// destroyed elsewhere
+		template<typename Predicate>
+		void evictIf(Predicate&& predicate)
+		{
+			for (auto index = expiry_head; index != invalid_index;)
+			{
+				auto next = m_entries[index].next_expiry;
+				if (predicate(*m_entries[index].resource))
+				{
+					evictEntry(index);
+					eviction_count++;
+				}
+				index = next;
+			}
+		}
 
 	protected:
 		virtual ResourceType* getResource_impl(const ResourceDescriptor& descriptor) = 0;
 		virtual void destroyResource_impl(ResourceType* resource) = 0;
+		// memory held by a resource, only used for the stats and the budgets
+		virtual uint64_t resourceSize(const ResourceDescriptor&) const { return 0; }
+
+		// whether an idle resource of the descriptor waits in this pool
+		bool hasResource(const ResourceDescriptor& descriptor) const
+		{
+			return findKey(descriptor, ResourceDescriptorHasher()(descriptor)) != invalid_index;
+		}
+
+	private:
+		// destroys the least recently used idle resource, or hands it upstream
+		bool evictOldest()
+		{
+			if (expiry_head == invalid_index)
+				return false;
+			evictEntry(expiry_head);
+			return true;
+		}
+
+		void evictEntry(uint32_t index)
+		{
+			auto resource = m_entries[index].resource;
+			auto descriptor = m_keys[m_entries[index].key].descriptor;
+			removeEntry(index);
+			if (m_upstream)
+				m_upstream->releaseResource(resource);
+			else
+				destroyResource(descriptor, resource);
+		}
+
+		void destroyResource(const ResourceDescriptor& descriptor, ResourceType* resource)
+		{
+			destroyResource_impl(resource);
+			resident_count--;
+			auto size = resourceSize(descriptor);
+			resident_bytes -= size;
+			if (shared_budget)
+				shared_budget->current_bytes -= size;
+		}
+
+		void addResidentBytes(uint64_t size)
+		{
+			resident_bytes += size;
+			peak_resident_bytes = std::max(peak_resident_bytes, resident_bytes);
+			if (shared_budget)
+			{
+				shared_budget->current_bytes += size;
+				shared_budget->peak_bytes = std::max(shared_budget->peak_bytes, shared_budget->current_bytes);
+			}
+		}
+
+		// fibonacci hashing, the table size is a power of two and the high bits of the product are the best mixed
+		size_t bucketOf(size_t hash) const
+		{
+			return (size_t)(((uint64_t)hash * 0x9e3779b97f4a7c15ull) >> bucket_shift);
+		}
+
+		uint32_t findKey(const ResourceDescriptor& descriptor, size_t hash) const
+		{
+			if (m_buckets.empty())
+				return invalid_index;
+			size_t mask = m_buckets.size() - 1;
+			for (size_t i = bucketOf(hash); ; i = (i + 1) & mask)
+			{
+				auto key = m_buckets[i];
+				if (key == invalid_index)
+					return invalid_index;
+				if (m_keys[key].hash == hash && ResourceDescriptorEq()(m_keys[key].descriptor, descriptor))
+					return key;
+			}
+		}
+
+		void insertBucket(uint32_t key)
+		{
+			size_t mask = m_buckets.size() - 1;
+			size_t i = bucketOf(m_keys[key].hash);
+			while (m_buckets[i] != invalid_index)
+				i = (i + 1) & mask;
+			m_buckets[i] = key;
+		}
+
+		void growBuckets()
+		{
+			auto old_buckets = std::move(m_buckets);
+			m_buckets = std::pmr::vector<uint32_t>(old_buckets.get_allocator());
+			m_buckets.assign(old_buckets.empty() ? 16 : old_buckets.size() * 2, invalid_index);
+			bucket_shift = 64 - std::countr_zero((uint64_t)m_buckets.size());
+			for (auto key : old_buckets)
+			{
+				if (key != invalid_index)
+					insertBucket(key);
+			}
+		}
+
+		uint32_t insertKey(const ResourceDescriptor& descriptor, size_t hash)
+		{
+			// at most three quarters full, so probes stay short
+			if ((key_count + 1) * 4 > m_buckets.size() * 3)
+				growBuckets();
+
+			uint32_t key;
+			if (free_keys != invalid_index)
+			{
+				key = free_keys;
+				free_keys = m_keys[key].head;
+				m_keys[key] = KeyRecord{ descriptor, hash, invalid_index };
+			}
+			else
+			{
+				key = (uint32_t)m_keys.size();
+				m_keys.push_back(KeyRecord{ descriptor, hash, invalid_index });
+			}
+			insertBucket(key);
+			key_count++;
+			return key;
+		}
+
+		// backward shift deletion, the table keeps no tombstones
+		void eraseKey(uint32_t key)
+		{
+			size_t mask = m_buckets.size() - 1;
+			size_t i = bucketOf(m_keys[key].hash);
+			while (m_buckets[i] != key)
+				i = (i + 1) & mask;
+			for (size_t j = (i + 1) & mask; m_buckets[j] != invalid_index; j = (j + 1) & mask)
+			{
+				size_t home = bucketOf(m_keys[m_buckets[j]].hash);
+				if (((j - home) & mask) >= ((j - i) & mask))
+				{
+					m_buckets[i] = m_buckets[j];
+					i = j;
+				}
+			}
+			m_buckets[i] = invalid_index;
+
+			m_keys[key].head = free_keys;
+			free_keys = key;
+			key_count--;
+		}
+
+		void linkExpiry(uint32_t index)
+		{
+			auto& entry = m_entries[index];
+			entry.prev_expiry = expiry_tail;
+			entry.next_expiry = invalid_index;
+			if (expiry_tail != invalid_index)
+				m_entries[expiry_tail].next_expiry = index;
+			else
+				expiry_head = index;
+			expiry_tail = index;
+		}
+
+		void unlinkExpiry(uint32_t index)
+		{
+			auto& entry = m_entries[index];
+			if (entry.prev_expiry != invalid_index)
+				m_entries[entry.prev_expiry].next_expiry = entry.next_expiry;
+			else
+				expiry_head = entry.next_expiry;
+			if (entry.next_expiry != invalid_index)
+				m_entries[entry.next_expiry].prev_expiry = entry.prev_expiry;
+			else
+				expiry_tail = entry.prev_expiry;
+		}
+
+		void addEntry(const ResourceDescriptor& descriptor, ResourceType* resource)
+		{
+			auto hash = ResourceDescriptorHasher()(descriptor);
+			auto key = findKey(descriptor, hash);
+			if (key == invalid_index)
+				key = insertKey(descriptor, hash);
+
+			uint32_t index;
+			if (free_entries != invalid_index)
+			{
+				index = free_entries;
+				free_entries = m_entries[index].next_same;
+			}
+			else
+			{
+				index = (uint32_t)m_entries.size();
+				m_entries.emplace_back();
+			}
+
+			// the newest entry is handed out first, it is the most likely to still be warm
+			auto& record = m_keys[key];
+			auto& entry = m_entries[index];
+			entry.resource = resource;
+			entry.timestamp = timestamp;
+			entry.key = key;
+			entry.prev_same = invalid_index;
+			entry.next_same = record.head;
+			if (record.head != invalid_index)
+				m_entries[record.head].prev_same = index;
+			record.head = index;
+			linkExpiry(index);
+
+			idle_count++;
+			idle_bytes += resourceSize(descriptor);
+		}
+
+		void removeEntry(uint32_t index)
+		{
+			auto& entry = m_entries[index];
+			auto& record = m_keys[entry.key];
+			idle_count--;
+			idle_bytes -= resourceSize(record.descriptor);
+
+			if (entry.prev_same != invalid_index)
+				m_entries[entry.prev_same].next_same = entry.next_same;
+			else
+				record.head = entry.next_same;
+			if (entry.next_same != invalid_index)
+				m_entries[entry.next_same].prev_same = entry.prev_same;
+			if (record.head == invalid_index)
+				eraseKey(entry.key);
+			unlinkExpiry(index);
+
+			entry.next_same = free_entries;
+			free_entries = index;
+		}
+
+		void clearEntries()
+		{
+			m_buckets.clear();
+			m_keys.clear();
+			m_entries.clear();
+			bucket_shift = 64;
+			key_count = 0;
+			free_keys = invalid_index;
+			free_entries = invalid_index;
+			expiry_head = invalid_index;
+			expiry_tail = invalid_index;
+			idle_count = 0;
+			idle_bytes = 0;
+		}
 
 	protected:
-		MapType m_resources;
 		ThisType* m_upstream = nullptr;
 		uint64_t timestamp = { 0 };
 		uint64_t frame_before_out_of_data = { 10 };
+		uint32_t resident_count = { 0 };
+		uint64_t resident_bytes = { 0 };
+		uint64_t peak_resident_bytes = { 0 };
+		uint64_t budget_bytes = { 0 };
+		ResourceBudget* shared_budget = { nullptr };
+		uint32_t idle_count = { 0 };
+		uint64_t idle_bytes = { 0 };
+		uint64_t hit_count = { 0 };
+		uint64_t miss_count = { 0 };
+		uint64_t eviction_count = { 0 };
+		uint64_t budget_eviction_count = { 0 };
+		uint64_t create_time_ns = { 0 };
+		uint64_t max_create_time_ns = { 0 };
+
+	private:
+		std::pmr::vector<uint32_t> m_buckets;
+		std::pmr::vector<KeyRecord> m_keys;
+		std::pmr::vector<Entry> m_entries;
+		uint32_t bucket_shift = { 64 };
+		size_t key_count = { 0 };
+		uint32_t free_keys = { invalid_index };
+		uint32_t free_entries = { invalid_index };
+		uint32_t expiry_head = { invalid_index };
+		uint32_t expiry_tail = { invalid_index };
 	};
 }
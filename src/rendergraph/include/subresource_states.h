@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <memory_resource>
+#include <algorithm>
+
+namespace HGEGraphics
+{
+	// per-subresource values of a texture kept as runs of consecutive subresources sharing a value,
+	// subresources are numbered mip first, then array layer. a texture in one state is a single run
+	template<typename T>
+	class SubresourceStates
+	{
+	public:
+		struct Run
+		{
+			uint32_t first;
+			uint32_t count;
+			T value;
+		};
+
+		SubresourceStates(std::pmr::memory_resource* const memory_resource = std::pmr::get_default_resource())
+			: runs(memory_resource)
+		{
+		}
+
+		void reset(uint32_t mip_count, uint32_t array_size, const T& value)
+		{
+			mips = std::max<uint32_t>(mip_count, 1);
+			total = mips * std::max<uint32_t>(array_size, 1);
+			runs.clear();
+			runs.push_back({ 0, total, value });
+		}
+
+		void clear()
+		{
+			runs.clear();
+			mips = 0;
+			total = 0;
+		}
+
+		uint32_t size() const { return total; }
+		uint32_t mip_count() const { return mips; }
+		bool uniform() const { return runs.size() <= 1; }
+		const std::pmr::vector<Run>& ranges() const { return runs; }
+
+		const T& get(uint32_t index) const
+		{
+			return runs[find(index)].value;
+		}
+
+		void set(uint32_t first, uint32_t count, const T& value)
+		{
+			assert(first + count <= total);
+			if (count == 0)
+				return;
+
+			const uint32_t end = first + count;
+			const size_t i = find(first);
+			const size_t j = find(end - 1) + 1;
+			const Run left = runs[i];
+			const Run right = runs[j - 1];
+
+			Run replacement[3];
+			size_t replacement_count = 0;
+			if (left.first < first)
+				replacement[replacement_count++] = { left.first, first - left.first, left.value };
+			const size_t mid = i + replacement_count;
+			replacement[replacement_count++] = { first, count, value };
+			if (right.first + right.count > end)
+				replacement[replacement_count++] = { end, right.first + right.count - end, right.value };
+
+			runs.erase(runs.begin() + i, runs.begin() + j);
+			runs.insert(runs.begin() + i, replacement, replacement + replacement_count);
+
+			if (mid + 1 < runs.size() && runs[mid + 1].value == value)
+			{
+				runs[mid].count += runs[mid + 1].count;
+				runs.erase(runs.begin() + mid + 1);
+			}
+			if (mid > 0 && runs[mid - 1].value == value)
+			{
+				runs[mid - 1].count += runs[mid].count;
+				runs.erase(runs.begin() + mid);
+			}
+		}
+
+		// calls visitor(first, count, value) for every run overlapping [first, first + count), clipped to it
+		template<typename Visitor>
+		void visit(uint32_t first, uint32_t count, Visitor&& visitor) const
+		{
+			if (count == 0)
+				return;
+
+			const uint32_t end = first + count;
+			for (size_t i = find(first); i < runs.size() && runs[i].first < end; ++i)
+			{
+				auto& run = runs[i];
+				auto run_first = std::max(run.first, first);
+				auto run_end = std::min(run.first + run.count, end);
+				visitor(run_first, run_end - run_first, run.value);
+			}
+		}
+
+	private:
+		size_t find(uint32_t index) const
+		{
+			assert(index < total);
+			auto iter = std::upper_bound(runs.begin(), runs.end(), index, [](uint32_t index, const Run& run) { return index < run.first; });
+			return iter - runs.begin() - 1;
+		}
+
+		std::pmr::vector<Run> runs;
+		uint32_t mips{ 0 };
+		uint32_t total{ 0 };
+	};
+}
@@ -12,7 +12,10 @@ namespace HGEGraphics
 		uint16_t height = 0;
 		uint16_t depth = 0;
 		uint16_t mipLevels = 0;
+		uint16_t arraySize = 1;
 		ECGPUTextureFormat format = CGPU_TEXTURE_FORMAT_UNDEFINED;
+		// cube and rw texture usage, on top of sampling and rendering to it
+		ECGPUResourceTypeFlags descriptors = CGPU_RESOURCE_TYPE_NONE;
 
 		bool operator==(const TextureDescriptor& other) const;
 	};
@@ -26,7 +29,9 @@ namespace HGEGraphics
 			hash_combine(seed, xyz.height);
 			hash_combine(seed, xyz.depth);
 			hash_combine(seed, xyz.mipLevels);
+			hash_combine(seed, xyz.arraySize);
 			hash_combine(seed, xyz.format);
+			hash_combine(seed, xyz.descriptors);
 
 			return seed;
 		}
@@ -50,14 +55,33 @@ namespace HGEGraphics
 		TexturePool(TexturePool* upstream, std::pmr::memory_resource* const memory_resource);
 
 		TextureWrap* getTexture(uint16_t width, uint16_t height, uint16_t depth, ECGPUTextureFormat format);
+		TextureWrap* getTexture(const TextureDescriptor& descriptor);
+
+		// rounds width and height up to a multiple of granularity before looking for a texture, so requests a few
+		// pixels apart share one allocation. 0 asks for the exact size. the texture can then be larger than asked for,
+		// passes rendering to it keep to the asked size, shaders sampling it have to scale their coordinates
+		void setSizeBucketing(uint16_t granularity);
+		TextureDescriptor bucketed(const TextureDescriptor& descriptor) const;
+
+	protected:
+		uint64_t resourceSize(const TextureDescriptor& descriptor) const override;
+
+	private:
+		uint16_t size_granularity = 0;
 	};
 
+	struct ExecutorContext;
 	class CgpuTexturePool
 		: public TexturePool
 	{
 	public:
 		CgpuTexturePool(CGPUDeviceId device, CGPUQueueId gfx_queue, TexturePool* upstream, std::pmr::memory_resource* const memory_resource);
 
+		// contexts keeping views and framebuffers of the textures of this pool, they forget a texture before it is
+		// destroyed, however early an eviction destroys it
+		void addDependentContext(ExecutorContext* context);
+		void removeDependentContext(ExecutorContext* context);
+
 	protected:
 		TextureWrap* getResource_impl(const TextureDescriptor& descriptor) override;
 		void destroyResource_impl(TextureWrap* resource) override;
@@ -66,5 +90,6 @@ namespace HGEGraphics
 		CGPUDeviceId device;
 		CGPUQueueId gfx_queue;
 		std::pmr::polymorphic_allocator<> allocator;
+		std::pmr::vector<ExecutorContext*> dependent_contexts;
 	};
 }
@@ -20,4 +20,8 @@ namespace HGEGraphics
 		cgpu_device_free_buffer(resource->handle->device, resource->handle);
 		allocator.delete_object(resource);
 	}
+	uint64_t BufferPool::resourceSize(const CGPUBufferDescriptor& descriptor) const
+	{
+		return descriptor.size;
+	}
 }
\ No newline at end of file
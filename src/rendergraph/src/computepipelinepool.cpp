@@ -1,11 +1,12 @@
 #include "computepipelinepool.h"
 
 #include "renderer.h"
+#include "pipelinecache.h"
 
 namespace HGEGraphics
 {
 	ComputePipelinePool::ComputePipelinePool(CGPUDeviceId device, ComputePipelinePool* upstream, std::pmr::memory_resource* const memory_resource)
-		: device(device), ResourcePool(12, upstream, memory_resource), allocator(memory_resource)
+		: device(device), ResourcePool(12, upstream, memory_resource), prepared_pipelines(memory_resource), allocator(memory_resource)
 	{
 	}
 
@@ -15,13 +16,56 @@ namespace HGEGraphics
 		return getResource(key);
 	}
 
-	ComputePipeline* ComputePipelinePool::getResource_impl(const CPSOKey& key)
+	ComputePipeline* ComputePipelinePool::getComputePipeline(ComputeShader* shader, std::mutex& mutex)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto pool = creator();
+		if (!pool->prepared_pipelines.contains(shader) && !pool->hasResource(shader))
+		{
+			lock.unlock();
+			auto handle = pool->createPipeline(shader);
+			lock.lock();
+			// another thread got there first
+			if (pool->prepared_pipelines.contains(shader) || pool->hasResource(shader))
+				cgpu_device_free_compute_pipeline(device, handle);
+			else if (handle)
+				pool->prepared_pipelines.emplace(shader, handle);
+		}
+		return getResource(shader);
+	}
+
+	CGPUComputePipelineId ComputePipelinePool::createPipeline(const CPSOKey& key) const
 	{
 		CGPUComputePipelineDescriptor cp_desc = {
 			.root_signature = key->root_sig,
 			.compute_shader = &key->cs,
 		};
-		auto handle = cgpu_device_create_compute_pipeline(device, &cp_desc);
+		return cgpu_device_create_compute_pipeline(device, &cp_desc);
+	}
+
+	void ComputePipelinePool::destroy()
+	{
+		for (auto& [key, handle] : prepared_pipelines)
+			cgpu_device_free_compute_pipeline(device, handle);
+		prepared_pipelines.clear();
+		ResourcePool::destroy();
+	}
+
+	ComputePipeline* ComputePipelinePool::getResource_impl(const CPSOKey& key)
+	{
+		CGPUComputePipelineId handle;
+		auto iter = prepared_pipelines.find(key);
+		if (iter != prepared_pipelines.end())
+		{
+			handle = iter->second;
+			prepared_pipelines.erase(iter);
+		}
+		else
+			handle = createPipeline(key);
+		if (pipeline_cache)
+			pipeline_cache->addComputePipeline(key->content_hash);
+		if (pipeline_manifest)
+			pipeline_manifest->addComputePipeline(key->content_hash);
 
 		auto pipeline = allocator.new_object<ComputePipeline>();
 		pipeline->handle = handle;
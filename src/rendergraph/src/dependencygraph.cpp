@@ -24,10 +24,14 @@
 namespace HGEGraphics {
 
 DependencyGraph::DependencyGraph(size_t node_count, size_t edge_count, std::pmr::memory_resource* const resource) noexcept
-    : mNodes(resource), mEdges(resource)
+    : mNodes(resource), mEdges(resource), mIncoming(resource), mOutgoing(resource), mLinks(resource), mEdgeLookup(resource)
 {
     mNodes.reserve(node_count);
     mEdges.reserve(edge_count);
+    mIncoming.reserve(node_count);
+    mOutgoing.reserve(node_count);
+    mLinks.reserve(edge_count);
+    mEdgeLookup.reserve(edge_count);
 }
 
 DependencyGraph::~DependencyGraph() noexcept = default;
@@ -39,6 +43,8 @@ uint32_t DependencyGraph::generateNodeId() noexcept {
 void DependencyGraph::registerNode(Node* node, NodeID id) noexcept {
     assert(id == mNodes.size());
     mNodes.push_back(node);
+    mIncoming.emplace_back();
+    mOutgoing.emplace_back();
 }
 
 bool DependencyGraph::isEdgeValid(DependencyGraph::Edge const* edge) const noexcept {
@@ -49,7 +55,21 @@ bool DependencyGraph::isEdgeValid(DependencyGraph::Edge const* edge) const noexc
 }
 
 void DependencyGraph::link(DependencyGraph::Edge* edge) noexcept {
+    uint32_t const index = mEdges.size();
     mEdges.push_back(edge);
+    mLinks.emplace_back();
+
+    auto append = [this, index](EdgeList& list, uint32_t EdgeLinks::* next) {
+        if (list.last == INVALID_INDEX) {
+            list.first = index;
+        } else {
+            mLinks[list.last].*next = index;
+        }
+        list.last = index;
+    };
+    append(mIncoming[edge->toID()], &EdgeLinks::nextIncoming);
+    append(mOutgoing[edge->fromID()], &EdgeLinks::nextOutgoing);
+    mEdgeLookup.try_emplace(edgeKey(edge->fromID(), edge->toID()), index);
 }
 
 DependencyGraph::EdgeContainer const& DependencyGraph::getEdges() const noexcept {
@@ -63,25 +83,19 @@ DependencyGraph::NodeContainer const& DependencyGraph::getNodes() const noexcept
 
 DependencyGraph::EdgeContainer DependencyGraph::getIncomingEdges(
         DependencyGraph::Node const* node) const noexcept {
-    // TODO: we might need something more efficient
-    auto result = EdgeContainer();
-    result.reserve(mEdges.size());
-    NodeID const nodeId = node->getID();
-    std::copy_if(mEdges.begin(), mEdges.end(),
-            std::back_insert_iterator<EdgeContainer>(result),
-            [nodeId](auto edge) { return edge->toID() == nodeId; });
+    auto result = EdgeContainer(mEdges.get_allocator());
+    for (uint32_t i = mIncoming[node->getID()].first; i != INVALID_INDEX; i = mLinks[i].nextIncoming) {
+        result.push_back(mEdges[i]);
+    }
     return result;
 }
 
 DependencyGraph::EdgeContainer DependencyGraph::getOutgoingEdges(
         DependencyGraph::Node const* node) const noexcept {
-    // TODO: we might need something more efficient
-    auto result = EdgeContainer();
-    result.reserve(mEdges.size());
-    NodeID const nodeId = node->getID();
-    std::copy_if(mEdges.begin(), mEdges.end(),
-            std::back_insert_iterator<EdgeContainer>(result),
-            [nodeId](auto edge) { return edge->fromID() == nodeId; });
+    auto result = EdgeContainer(mEdges.get_allocator());
+    for (uint32_t i = mOutgoing[node->getID()].first; i != INVALID_INDEX; i = mLinks[i].nextOutgoing) {
+        result.push_back(mEdges[i]);
+    }
     return result;
 }
 
@@ -95,13 +109,8 @@ DependencyGraph::Node* DependencyGraph::getNode(DependencyGraph::NodeID id) noex
 
 DependencyGraph::Edge* DependencyGraph::getEdge(NodeID from, NodeID to)
 {
-    for (auto edge : mEdges)
-    {
-        if (edge->fromID() == from && edge->toID() == to)
-            return edge;
-    }
-
-    return nullptr;
+    auto pos = mEdgeLookup.find(edgeKey(from, to));
+    return pos != mEdgeLookup.end() ? mEdges[pos->second] : nullptr;
 }
 
 void DependencyGraph::cull() noexcept {
@@ -115,7 +124,7 @@ void DependencyGraph::cull() noexcept {
     }
 
     // cull nodes with a 0 reference count
-    auto stack = NodeContainer();
+    auto stack = NodeContainer(mNodes.get_allocator());
     stack.reserve(mNodes.size());
     for (Node* const pNode : nodes) {
         if (pNode->getRefCount() == 0) {
@@ -125,9 +134,8 @@ void DependencyGraph::cull() noexcept {
     while (!stack.empty()) {
         Node* const pNode = stack.back();
         stack.pop_back();
-        EdgeContainer const& incoming = getIncomingEdges(pNode);
-        for (Edge* edge : incoming) {
-            Node* pLinkedNode = getNode(edge->fromID());
+        for (uint32_t i = mIncoming[pNode->getID()].first; i != INVALID_INDEX; i = mLinks[i].nextIncoming) {
+            Node* pLinkedNode = getNode(edges[i]->fromID());
             if (--pLinkedNode->mRefCount == 0) {
                 stack.push_back(pLinkedNode);
             }
@@ -138,6 +146,10 @@ void DependencyGraph::cull() noexcept {
 void DependencyGraph::clear() noexcept {
     mEdges.clear();
     mNodes.clear();
+    mIncoming.clear();
+    mOutgoing.clear();
+    mLinks.clear();
+    mEdgeLookup.clear();
 }
 
 void DependencyGraph::export_graphviz(std::ostream& out, char const* name) {
@@ -193,46 +205,33 @@ void DependencyGraph::export_graphviz(std::ostream& out, char const* name) {
 }
 
 bool DependencyGraph::isAcyclic() const noexcept {
-#ifndef NDEBUG
-    // We work on a copy of the graph
-    std::pmr::unsynchronized_pool_resource pool;
-    DependencyGraph graph(mNodes.size(), mEdges.size(), &pool);
-    graph.mEdges = mEdges;
-    graph.mNodes = mNodes;
-    return DependencyGraph::isAcyclicInternal(graph);
-#else
-    return true;
-#endif
-}
-bool DependencyGraph::isAcyclicInternal(DependencyGraph& graph) noexcept {
-#ifndef NDEBUG
-    while (!graph.mNodes.empty() && !graph.mEdges.empty()) {
-        // check if we have at lest one leaf (i.e. nodes that have incoming but no outgoing edges)
-        auto pos = std::find_if(graph.mNodes.begin(), graph.mNodes.end(),
-                [&graph](Node const* node) {
-                    auto pos = std::find_if(graph.mEdges.begin(), graph.mEdges.end(),
-                            [node](Edge const* edge) {
-                                return edge->fromID() == node->getID();
-                            });
-                    return pos == graph.mEdges.end();
-                });
-
-        if (pos == graph.mNodes.end()) {
-            return false;   // cyclic
-        }
+    // Kahn's algorithm: repeatedly remove the nodes nothing points to anymore,
+    // whatever is left afterwards is part of a cycle
+    std::pmr::vector<uint32_t> inDegree(mNodes.size(), 0, mNodes.get_allocator());
+    for (Edge const* edge : mEdges) {
+        inDegree[edge->toID()]++;
+    }
 
-        // remove the leaf's edges
-        auto last = std::remove_if(graph.mEdges.begin(), graph.mEdges.end(),
-                [&pos](Edge const* edge) {
-            return edge->toID() == (*pos)->getID() || edge->fromID() == (*pos)->getID();
-        });
-        graph.mEdges.erase(last, graph.mEdges.end());
+    std::pmr::vector<NodeID> stack(mNodes.get_allocator());
+    stack.reserve(mNodes.size());
+    for (NodeID id = 0; id < mNodes.size(); ++id) {
+        if (inDegree[id] == 0) {
+            stack.push_back(id);
+        }
+    }
 
-        // remove the leaf
-        graph.mNodes.erase(pos);
+    size_t removed = 0;
+    while (!stack.empty()) {
+        NodeID const id = stack.back();
+        stack.pop_back();
+        ++removed;
+        for (uint32_t i = mOutgoing[id].first; i != INVALID_INDEX; i = mLinks[i].nextOutgoing) {
+            if (--inDegree[mEdges[i]->toID()] == 0) {
+                stack.push_back(mEdges[i]->toID());
+            }
+        }
     }
-#endif
-    return true; // acyclic
+    return removed == mNodes.size();
 }
 
 // ------------------------------------------------------------------------------------------------
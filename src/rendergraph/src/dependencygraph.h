@@ -17,6 +17,8 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
+#include <memory_resource>
 #include <string>
 #include <ostream>
 #include <cassert>
@@ -146,14 +148,16 @@ public:
     NodeContainer const& getNodes() const noexcept;
 
     /**
-     * Returns the list of incoming edges to a node
+     * Returns the list of incoming edges to a node, in the order they were created.
+     * Runs in time proportional to the number of edges returned.
      * @param node the node to consider
      * @return A list of incoming edges
      */
     EdgeContainer getIncomingEdges(Node const* node) const noexcept;
 
     /**
-     * Returns the list of outgoing edges to a node
+     * Returns the list of outgoing edges to a node, in the order they were created.
+     * Runs in time proportional to the number of edges returned.
      * @param node the node to consider
      * @return A list of outgoing edges
      */
@@ -163,6 +167,7 @@ public:
 
     Node* getNode(NodeID id) noexcept;
 
+    //! returns the first edge created between two nodes, nullptr if there is none. constant time
     Edge* getEdge(NodeID from, NodeID to);
 
     //! cull unreferenced nodes. Links ARE NOT removed, only reference counts are updated.
@@ -178,16 +183,38 @@ public:
     //! export a graphviz view of the graph
     void export_graphviz(std::ostream& out, const char* name = nullptr);
 
+    //! linear in the number of nodes and edges, available in every build
     bool isAcyclic() const noexcept;
 
 private:
+    static const constexpr uint32_t INVALID_INDEX = 0xFFFFFFFFu;
+
+    // edges of a node chained through the indices of mEdges, in creation order
+    struct EdgeList {
+        uint32_t first = INVALID_INDEX;
+        uint32_t last = INVALID_INDEX;
+    };
+
+    // next edge with the same destination and the same source
+    struct EdgeLinks {
+        uint32_t nextIncoming = INVALID_INDEX;
+        uint32_t nextOutgoing = INVALID_INDEX;
+    };
+
+    static uint64_t edgeKey(NodeID from, NodeID to) noexcept {
+        return (uint64_t(from) << 32) | to;
+    }
+
     // id must be the node key in the NodeContainer
     uint32_t generateNodeId() noexcept;
     void registerNode(Node* node, NodeID id) noexcept;
     void link(Edge* edge) noexcept;
-    static bool isAcyclicInternal(DependencyGraph& graph) noexcept;
     NodeContainer mNodes;
     EdgeContainer mEdges;
+    std::pmr::vector<EdgeList> mIncoming;
+    std::pmr::vector<EdgeList> mOutgoing;
+    std::pmr::vector<EdgeLinks> mLinks;
+    std::pmr::unordered_map<uint64_t, uint32_t> mEdgeLookup;
 };
 
 inline DependencyGraph::Edge::Edge(DependencyGraph& graph,
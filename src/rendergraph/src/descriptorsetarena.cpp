@@ -0,0 +1,100 @@
+#include "descriptorsetarena.h"
+#include <cassert>
+#include <algorithm>
+
+namespace HGEGraphics
+{
+	DescriptorSetArenas::RootSignatureArenas::RootSignatureArenas(std::pmr::memory_resource* const memory_resource)
+		: arenas{ { std::pmr::vector<CGPUDescriptorSetId>(memory_resource) }, { std::pmr::vector<CGPUDescriptorSetId>(memory_resource) }, { std::pmr::vector<CGPUDescriptorSetId>(memory_resource) }, { std::pmr::vector<CGPUDescriptorSetId>(memory_resource) } }
+	{
+	}
+
+	DescriptorSetArenas::DescriptorSetArenas(CGPUDeviceId device, std::pmr::memory_resource* const memory_resource)
+		: device(device), memory_resource(memory_resource), root_signatures(memory_resource)
+	{
+	}
+
+	CGPUDescriptorSetId DescriptorSetArenas::acquire(CGPURootSignatureId root_signature, uint32_t set_index)
+	{
+		assert(set_index < max_set_count);
+		if (root_signature != last_root_signature)
+		{
+			last_root_signature = root_signature;
+			last_arenas = &root_signatures.try_emplace(root_signature, memory_resource).first->second;
+		}
+		last_arenas->timestamp = timestamp;
+
+		auto& arena = last_arenas->arenas[set_index];
+		++acquired;
+		if (arena.used < arena.sets.size())
+			return arena.sets[arena.used++];
+
+		CGPUDescriptorSetDescriptor dset_desc =
+		{
+			.root_signature = root_signature,
+			.set_index = set_index,
+		};
+		auto handle = cgpu_device_create_descriptor_set(device, &dset_desc);
+		arena.sets.push_back(handle);
+		arena.used++;
+		++resident;
+		++created;
+		return handle;
+	}
+
+	void DescriptorSetArenas::reset()
+	{
+		peak_acquired = std::max(peak_acquired, acquired);
+		acquired = 0;
+		++timestamp;
+
+		for (auto iter = root_signatures.begin(); iter != root_signatures.end();)
+		{
+			auto& root_signature_arenas = iter->second;
+			if (timestamp > root_signature_arenas.timestamp + frames_before_out_of_date)
+			{
+				for (auto& arena : root_signature_arenas.arenas)
+				{
+					for (auto set : arena.sets)
+						cgpu_device_free_descriptor_set(device, set);
+					resident -= arena.sets.size();
+				}
+				iter = root_signatures.erase(iter);
+				continue;
+			}
+			for (auto& arena : root_signature_arenas.arenas)
+				arena.used = 0;
+			++iter;
+		}
+		last_root_signature = CGPU_NULLPTR;
+		last_arenas = nullptr;
+	}
+
+	void DescriptorSetArenas::destroy()
+	{
+		for (auto& [root_signature, root_signature_arenas] : root_signatures)
+		{
+			for (auto& arena : root_signature_arenas.arenas)
+			{
+				for (auto set : arena.sets)
+					cgpu_device_free_descriptor_set(device, set);
+			}
+		}
+		root_signatures.clear();
+		last_root_signature = CGPU_NULLPTR;
+		last_arenas = nullptr;
+		acquired = 0;
+		resident = 0;
+	}
+
+	DescriptorSetArenaStats DescriptorSetArenas::stats() const
+	{
+		DescriptorSetArenaStats stats;
+		stats.arena_count = (uint32_t)root_signatures.size();
+		stats.acquired = acquired;
+		stats.peak_acquired = std::max(peak_acquired, acquired);
+		stats.resident = resident;
+		stats.created = created;
+		return stats;
+	}
+}
@@ -1,11 +1,16 @@
 #include "graphicspipelinepool.h"
 
 #include "renderer.h"
+#include "pipelinecache.h"
+#include "pipelinestates.h"
+#include <taskflow/taskflow.hpp>
+#include <thread>
+#include <cassert>
 
 namespace HGEGraphics
 {
 	GraphicsPipelinePool::GraphicsPipelinePool(CGPUDeviceId device, GraphicsPipelinePool* upstream, std::pmr::memory_resource* const memory_resource)
-		: device(device), ResourcePool(12, upstream, memory_resource), allocator(memory_resource)
+		: device(device), ResourcePool(12, upstream, memory_resource), prepared_pipelines(memory_resource), allocator(memory_resource)
 	{
 		if (device)
 		{
@@ -18,60 +23,180 @@ namespace HGEGraphics
 	}
 	GraphicsPipeline* GraphicsPipelinePool::getGraphicsPipeline(RenderPassEncoder* encoder, Shader* shader, Mesh* mesh)
     {
-		return getGraphicsPipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout);
+		return getGraphicsPipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout_id);
 	}
 
-	GraphicsPipeline* GraphicsPipelinePool::getGraphicsPipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology prim_topology, const CGPUVertexLayout& vertex_layout)
+	GraphicsPipeline* GraphicsPipelinePool::getGraphicsPipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology prim_topology, uint32_t vertex_layout)
 	{
+		return getResource(pipelineKey(encoder, shader, prim_topology, vertex_layout));
+	}
+
+	GraphicsPipeline* GraphicsPipelinePool::getGraphicsPipeline(const PSOKey& key, std::mutex& mutex)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto pool = creator();
+		// the executor is the creator's, the pool of a context never has one of its own
+		if (!compilesAsync() && !pool->isPrepared(key))
+		{
+			lock.unlock();
+			auto handle = pool->createPipeline(key);
+			lock.lock();
+			if (handle)
+				pool->addPreparedPipeline(key, handle);
+		}
+		return getResource(key);
+	}
+
+	PSOKey GraphicsPipelinePool::pipelineKey(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology prim_topology, uint32_t vertex_layout) const
+	{
+		assert(encoder->subpass < 256);
 		auto key = PSOKey
 		{
 			.shader = shader,
+			.render_pass = encoder->render_pass_resource,
 			.vertex_layout = vertex_layout,
-			.prim_topology = prim_topology,
-			.blend_desc = shader->blend_desc,
-			.depth_desc = shader->depth_desc,
-			.rasterizer_state = shader->rasterizer_state,
-			.render_pass = encoder->render_pass,
-			.subpass = encoder->subpass,
 			.render_target_count = encoder->render_target_count,
+			.blend_state = shader->blend_state_id,
+			.depth_state = shader->depth_state_id,
+			.rasterizer_state = shader->rasterizer_state_id,
+			.prim_topology = (uint8_t)prim_topology,
+			.subpass = (uint8_t)encoder->subpass,
 		};
 		if (dynamicStateT1Enabled())
 		{
-			key.prim_topology = (ECGPUPrimitiveTopology)0;
-			key.rasterizer_state.cull_mode = (ECGPUCullModeFlags)0;
-			key.rasterizer_state.front_face = (ECGPUFrontFace)0;
-			key.depth_desc.depth_test = false;
-			key.depth_desc.depth_write = false;
-			key.depth_desc.depth_op = (ECGPUCompareOp)0;
+			key.prim_topology = 0;
+			key.depth_state = shader->dynamic_depth_state_id;
+			key.rasterizer_state = shader->dynamic_rasterizer_state_id;
 		}
-		return getResource(key);
+		return key;
+	}
+
+	PSOKey GraphicsPipelinePool::pipelineKey(Shader* shader, const GraphicsPipelineDescription& description, const RenderPass* render_pass) const
+	{
+		auto& registry = pipeline_state_registry();
+		auto depth_desc = description.depth_desc;
+		auto rasterizer_state = description.rasterizer_state;
+		if (dynamicStateT1Enabled())
+			strip_dynamic_states_t1(depth_desc, rasterizer_state);
+		return PSOKey
+		{
+			.shader = shader,
+			.render_pass = render_pass,
+			.vertex_layout = registry.internVertexLayout(description.vertex_layout),
+			.render_target_count = description.render_target_count,
+			.blend_state = registry.internBlendState(description.blend_desc),
+			.depth_state = registry.internDepthState(depth_desc),
+			.rasterizer_state = registry.internRasterizerState(rasterizer_state),
+			.prim_topology = dynamicStateT1Enabled() ? (uint8_t)0 : (uint8_t)description.prim_topology,
+			.subpass = (uint8_t)description.subpass,
+		};
+	}
+
+	PreparedPSOKey GraphicsPipelinePool::preparedKey(const PSOKey& key)
+	{
+		PreparedPSOKey prepared_key = { .key = key, .render_pass = key.render_pass->_descriptor };
+		prepared_key.key.render_pass = nullptr;
+		return prepared_key;
+	}
+
+	void GraphicsPipelinePool::addPreparedPipeline(const PSOKey& key, CGPURenderPipelineId handle)
+	{
+		// another thread got there first
+		if (isPrepared(key))
+			cgpu_device_free_render_pipeline(device, handle);
+		else
+			prepared_pipelines.emplace(preparedKey(key), PreparedPipeline{ handle, timestamp });
+	}
+
+	void GraphicsPipelinePool::newFrame()
+	{
+		ResourcePool::newFrame();
+		std::erase_if(prepared_pipelines, [this](auto& kv) -> bool
+			{
+				bool out_of_date = timestamp > kv.second.timestamp + prepared_frames_before_out_of_date;
+				if (out_of_date)
+					cgpu_device_free_render_pipeline(device, kv.second.handle);
+				return out_of_date;
+			});
+	}
+
+	void GraphicsPipelinePool::destroy()
+	{
+		while (compiling_count.load())
+			std::this_thread::yield();
+		for (auto& [key, prepared] : prepared_pipelines)
+			cgpu_device_free_render_pipeline(device, prepared.handle);
+		prepared_pipelines.clear();
+		ResourcePool::destroy();
 	}
 
 	GraphicsPipeline* GraphicsPipelinePool::getResource_impl(const PSOKey& key)
 	{
+		CGPURenderPipelineId handle = CGPU_NULLPTR;
+		auto iter = prepared_pipelines.find(preparedKey(key));
+		if (iter != prepared_pipelines.end())
+		{
+			handle = iter->second.handle;
+			prepared_pipelines.erase(iter);
+		}
+		if (pipeline_cache || pipeline_manifest)
+		{
+			std::pmr::string record(allocator);
+			PipelineCache::encode(key, record);
+			if (pipeline_cache)
+				pipeline_cache->addGraphicsPipeline(record);
+			if (pipeline_manifest)
+				pipeline_manifest->addGraphicsPipeline(record);
+		}
+		auto pipeline = allocator.new_object<GraphicsPipeline>();
+		pipeline->handle = handle;
+		pipeline->_descriptor = key;
+		if (handle || !compile_executor)
+		{
+			if (!handle)
+				pipeline->handle = createPipeline(key);
+			return pipeline;
+		}
+
+		pipeline->ready.store(false, std::memory_order_relaxed);
+		key.shader->compiling_pipelines++;
+		compiling_count++;
+		// the key only holds ids and objects that outlive the pipeline, the task can take it as it is
+		compile_executor->silent_async([this, key, pipeline]()
+		{
+			pipeline->handle = createPipeline(key);
+			key.shader->compiling_pipelines--;
+			compiling_count--;
+			// last, once it is ready the pool and the shader can be destroyed under the task
+			pipeline->ready.store(true, std::memory_order_release);
+		});
+		return pipeline;
+	}
+
+	CGPURenderPipelineId GraphicsPipelinePool::createPipeline(const PSOKey& key) const
+	{
+		auto& registry = pipeline_state_registry();
 		CGPURenderPipelineDescriptor rp_desc = {
 			.dynamic_state = _dynamic_state_features,
 			.root_signature = key.shader->root_sig,
 			.vertex_shader = &key.shader->vs,
 			.fragment_shader = &key.shader->ps,
-			.vertex_layout = &key.vertex_layout,
-			.blend_state = &key.blend_desc,
-			.depth_state = &key.depth_desc,
-			.rasterizer_state = &key.rasterizer_state,
-			.render_pass = key.render_pass,
+			.vertex_layout = &registry.vertexLayout(key.vertex_layout),
+			.blend_state = &registry.blendState(key.blend_state),
+			.depth_state = &registry.depthState(key.depth_state),
+			.rasterizer_state = &registry.rasterizerState(key.rasterizer_state),
+			.render_pass = key.render_pass->renderPass,
 			.subpass = key.subpass,
 			.render_target_count = key.render_target_count,
-			.prim_topology = key.prim_topology,
+			.prim_topology = (ECGPUPrimitiveTopology)key.prim_topology,
 		};
-		auto handle = cgpu_device_create_render_pipeline(device, &rp_desc);
-
-		auto pipeline = allocator.new_object<GraphicsPipeline>();
-		pipeline->handle = handle;
-		return pipeline;
+		return cgpu_device_create_render_pipeline(device, &rp_desc);
 	}
 
     void GraphicsPipelinePool::destroyResource_impl(GraphicsPipeline* resource)
     {
+		while (!resource->ready.load(std::memory_order_acquire))
+			std::this_thread::yield();
 		cgpu_device_free_render_pipeline(device, resource->handle);
 		allocator.delete_object(resource);
     }
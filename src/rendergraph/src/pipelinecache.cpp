@@ -0,0 +1,201 @@
+#include "pipelinecache.h"
+
+#include "graphicspipelinepool.h"
+#include "pipelinestates.h"
+#include "renderer.h"
+#include "hash.h"
+#include "pipelinerecord.h"
+#include <string.h>
+#include <algorithm>
+
+namespace HGEGraphics
+{
+	// bump whenever the encoding below or the meaning of a cgpu enum written by it changes
+	const uint32_t pipeline_cache_magic = 0x43504748;
+	const uint32_t pipeline_cache_version = 2;
+
+	PipelineCacheIdentity pipeline_cache_identity(CGPUDeviceId device)
+	{
+		auto adapter_detail = cgpu_adapter_query_adapter_detail(device->adapter);
+		return PipelineCacheIdentity
+		{
+			.vendor_id = adapter_detail->vendor_preset.vendor_id,
+			.device_id = adapter_detail->vendor_preset.device_id,
+			.driver_version = adapter_detail->vendor_preset.driver_version,
+		};
+	}
+
+	GraphicsPipelineDescription::GraphicsPipelineDescription(std::pmr::memory_resource* const memory_resource)
+		: vertex_attributes(memory_resource), blend_attachment_states(memory_resource)
+	{
+	}
+
+	PipelineCache::PipelineCache(std::pmr::memory_resource* const memory_resource)
+		: graphics_records(memory_resource), compute_shaders(memory_resource)
+	{
+	}
+
+	void PipelineCache::encode(const PSOKey& key, std::pmr::string& record)
+	{
+		auto& registry = pipeline_state_registry();
+		record.clear();
+		PipelineRecordWriter writer{ record };
+		writer.u64(key.shader->content_hash);
+		writer(key.prim_topology);
+		pipeline_record_write_vertex_layout(writer, registry.vertexLayout(key.vertex_layout));
+		pipeline_record_write_blend_state(writer, registry.blendState(key.blend_state));
+		pipeline_record_depth_state(writer, registry.depthState(key.depth_state));
+		pipeline_record_rasterizer_state(writer, registry.rasterizerState(key.rasterizer_state));
+		pipeline_record_render_pass(writer, key.render_pass->_descriptor);
+		writer(key.subpass);
+		writer(key.render_target_count);
+	}
+
+	bool PipelineCache::decode(const std::pmr::string& record, GraphicsPipelineDescription& description)
+	{
+		PipelineRecordReader reader{ (const uint8_t*)record.data(), record.size() };
+		description.shader_hash = reader.u64();
+		reader(description.prim_topology);
+
+		auto attribute_count = reader.u32();
+		description.vertex_attributes.clear();
+		for (uint32_t i = 0; i < attribute_count && !reader.failed; ++i)
+		{
+			CGPUVertexAttribute attribute;
+			if (!pipeline_record_read_vertex_attribute(reader, attribute))
+				return false;
+			description.vertex_attributes.push_back(attribute);
+		}
+		description.vertex_layout = {};
+		description.vertex_layout.attribute_count = (uint32_t)description.vertex_attributes.size();
+		description.vertex_layout.p_attributes = description.vertex_attributes.data();
+
+		auto attachment_count = reader.u32();
+		description.blend_desc = {};
+		reader(description.blend_desc.alpha_to_coverage);
+		reader(description.blend_desc.independent_blend);
+		description.blend_attachment_states.clear();
+		for (uint32_t i = 0; i < attachment_count && !reader.failed; ++i)
+		{
+			CGPUBlendAttachmentState attachment = {};
+			pipeline_record_blend_attachment(reader, attachment);
+			description.blend_attachment_states.push_back(attachment);
+		}
+		description.blend_desc.attachment_count = (uint32_t)description.blend_attachment_states.size();
+		description.blend_desc.p_attachments = description.blend_attachment_states.data();
+
+		description.depth_desc = {};
+		pipeline_record_depth_state(reader, description.depth_desc);
+		description.rasterizer_state = {};
+		pipeline_record_rasterizer_state(reader, description.rasterizer_state);
+		description.render_pass = {};
+		pipeline_record_render_pass(reader, description.render_pass);
+		reader(description.subpass);
+		reader(description.render_target_count);
+		return !reader.failed && reader.offset == reader.size;
+	}
+
+	void PipelineCache::addGraphicsPipeline(const std::pmr::string& record)
+	{
+		graphics_records.insert_or_assign(record, 0);
+	}
+
+	void PipelineCache::addComputePipeline(uint64_t shader_hash)
+	{
+		compute_shaders.insert_or_assign(shader_hash, 0);
+	}
+
+	bool PipelineCache::hasComputePipeline(uint64_t shader_hash) const
+	{
+		return compute_shaders.contains(shader_hash);
+	}
+
+	uint64_t PipelineCache::recordShaderHash(const std::pmr::string& record)
+	{
+		PipelineRecordReader reader{ (const uint8_t*)record.data(), record.size() };
+		return reader.u64();
+	}
+
+	void PipelineCache::serialize(const PipelineCacheIdentity& identity, std::pmr::string& blob) const
+	{
+		blob.clear();
+		PipelineRecordWriter writer{ blob };
+		writer.u32(pipeline_cache_magic);
+		writer.u32(pipeline_cache_version);
+		writer.u32(identity.vendor_id);
+		writer.u32(identity.device_id);
+		writer.u32(identity.driver_version);
+
+		auto kept = [this](auto& kv) { return kv.second < max_idle_runs; };
+		writer.u32((uint32_t)std::count_if(graphics_records.begin(), graphics_records.end(), kept));
+		for (auto& [record, idle_runs] : graphics_records)
+		{
+			if (idle_runs >= max_idle_runs)
+				continue;
+			writer.u32((uint32_t)record.size());
+			writer.bytes(record.data(), record.size());
+			writer.u32(idle_runs);
+		}
+		writer.u32((uint32_t)std::count_if(compute_shaders.begin(), compute_shaders.end(), kept));
+		for (auto [shader_hash, idle_runs] : compute_shaders)
+		{
+			if (idle_runs >= max_idle_runs)
+				continue;
+			writer.u64(shader_hash);
+			writer.u32(idle_runs);
+		}
+
+		writer.u64(fnv1a64(blob.data(), blob.size()));
+	}
+
+	bool PipelineCache::deserialize(const PipelineCacheIdentity& identity, const uint8_t* data, size_t size)
+	{
+		if (size < sizeof(uint64_t))
+			return false;
+		PipelineRecordReader checksum_reader{ data + size - sizeof(uint64_t), sizeof(uint64_t) };
+		if (checksum_reader.u64() != fnv1a64(data, size - sizeof(uint64_t)))
+			return false;
+
+		PipelineRecordReader reader{ data, size - sizeof(uint64_t) };
+		if (reader.u32() != pipeline_cache_magic || reader.u32() != pipeline_cache_version)
+			return false;
+		if (reader.u32() != identity.vendor_id || reader.u32() != identity.device_id || reader.u32() != identity.driver_version)
+			return false;
+
+		auto memory_resource = graphics_records.get_allocator().resource();
+		std::pmr::vector<std::pmr::string> records(memory_resource);
+		std::pmr::vector<uint32_t> record_idle_runs(memory_resource);
+		GraphicsPipelineDescription description(memory_resource);
+		auto graphics_count = reader.u32();
+		for (uint32_t i = 0; i < graphics_count && !reader.failed; ++i)
+		{
+			auto record_size = reader.u32();
+			auto record_data = reader.bytes(record_size);
+			if (!record_data)
+				return false;
+			auto& record = records.emplace_back((const char*)record_data, record_size);
+			if (!decode(record, description))
+				return false;
+			record_idle_runs.push_back(reader.u32());
+		}
+
+		std::pmr::vector<uint64_t> shader_hashes(memory_resource);
+		std::pmr::vector<uint32_t> shader_idle_runs(memory_resource);
+		auto compute_count = reader.u32();
+		for (uint32_t i = 0; i < compute_count && !reader.failed; ++i)
+		{
+			shader_hashes.push_back(reader.u64());
+			shader_idle_runs.push_back(reader.u32());
+		}
+
+		if (reader.failed || reader.offset != reader.size)
+			return false;
+
+		// this run counts as one more without them until they are added again
+		for (size_t i = 0; i < records.size(); ++i)
+			graphics_records.try_emplace(records[i], record_idle_runs[i] + 1);
+		for (size_t i = 0; i < shader_hashes.size(); ++i)
+			compute_shaders.try_emplace(shader_hashes[i], shader_idle_runs[i] + 1);
+		return true;
+	}
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "cgpu/api.h"
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+namespace HGEGraphics
+{
+	// every value is written as little endian 32 bits, whatever its type and the platform
+	struct PipelineRecordWriter
+	{
+		std::pmr::string& out;
+
+		void u32(uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+				out.push_back((char)((value >> (i * 8)) & 0xff));
+		}
+
+		void u64(uint64_t value)
+		{
+			u32((uint32_t)value);
+			u32((uint32_t)(value >> 32));
+		}
+
+		void bytes(const void* data, size_t size)
+		{
+			out.append((const char*)data, size);
+		}
+
+		template<typename T>
+		void operator()(const T& value)
+		{
+			static_assert(sizeof(T) <= 4);
+			uint32_t bits = 0;
+			if constexpr (std::is_floating_point_v<T>)
+				memcpy(&bits, &value, sizeof(T));
+			else
+				bits = (uint32_t)value;
+			u32(bits);
+		}
+	};
+
+	struct PipelineRecordReader
+	{
+		const uint8_t* data;
+		size_t size;
+		size_t offset = 0;
+		bool failed = false;
+
+		const uint8_t* bytes(size_t count)
+		{
+			if (failed || size - offset < count)
+			{
+				failed = true;
+				return nullptr;
+			}
+			auto result = data + offset;
+			offset += count;
+			return result;
+		}
+
+		uint32_t u32()
+		{
+			auto p = bytes(4);
+			if (!p)
+				return 0;
+			return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+		}
+
+		uint64_t u64()
+		{
+			uint64_t low = u32();
+			uint64_t high = u32();
+			return low | (high << 32);
+		}
+
+		template<typename T>
+		void operator()(T& value)
+		{
+			static_assert(sizeof(T) <= 4);
+			uint32_t bits = u32();
+			if constexpr (std::is_floating_point_v<T>)
+				memcpy(&value, &bits, sizeof(T));
+			else
+				value = (T)bits;
+		}
+	};
+
+	// the field lists are shared by the writer and the reader so the two can not drift apart
+	template<typename Archive, typename Attribute>
+	void pipeline_record_vertex_attribute(Archive& archive, Attribute& attribute)
+	{
+		archive(attribute.array_size);
+		archive(attribute.format);
+		archive(attribute.binding);
+		archive(attribute.offset);
+		archive(attribute.elem_stride);
+		archive(attribute.rate);
+	}
+
+	template<typename Archive, typename Attachment>
+	void pipeline_record_blend_attachment(Archive& archive, Attachment& attachment)
+	{
+		archive(attachment.enable);
+		archive(attachment.src_factor);
+		archive(attachment.dst_factor);
+		archive(attachment.src_alpha_factor);
+		archive(attachment.dst_alpha_factor);
+		archive(attachment.blend_op);
+		archive(attachment.blend_alpha_op);
+		archive(attachment.color_mask);
+	}
+
+	template<typename Archive, typename DepthState>
+	void pipeline_record_depth_state(Archive& archive, DepthState& depth)
+	{
+		archive(depth.depth_test);
+		archive(depth.depth_write);
+		archive(depth.depth_op);
+		archive(depth.stencil_test);
+		archive(depth.stencil_read_mask);
+		archive(depth.stencil_write_mask);
+		archive(depth.stencil_front_op);
+		archive(depth.stencil_front_fail_op);
+		archive(depth.depth_front_fail_op);
+		archive(depth.stencil_front_pass_op);
+		archive(depth.stencil_back_op);
+		archive(depth.stencil_back_fail_op);
+		archive(depth.depth_back_fail_op);
+		archive(depth.stencil_back_pass_op);
+	}
+
+	template<typename Archive, typename RasterizerState>
+	void pipeline_record_rasterizer_state(Archive& archive, RasterizerState& rasterizer)
+	{
+		archive(rasterizer.cull_mode);
+		archive(rasterizer.depth_bias);
+		archive(rasterizer.slope_scaled_depth_bias);
+		archive(rasterizer.fill_mode);
+		archive(rasterizer.front_face);
+		archive(rasterizer.enable_multi_sample);
+		archive(rasterizer.enable_scissor);
+		archive(rasterizer.enable_depth_clamp);
+	}
+
+	template<typename Archive, typename RenderPass>
+	void pipeline_record_render_pass(Archive& archive, RenderPass& render_pass)
+	{
+		archive(render_pass.sample_count);
+		for (auto& color : render_pass.color_attachments)
+		{
+			archive(color.format);
+			archive(color.load_action);
+			archive(color.store_action);
+		}
+		archive(render_pass.depth_stencil.format);
+		archive(render_pass.depth_stencil.depth_load_action);
+		archive(render_pass.depth_stencil.depth_store_action);
+		archive(render_pass.depth_stencil.stencil_load_action);
+		archive(render_pass.depth_stencil.stencil_store_action);
+	}
+
+	// the name is written up to its terminator, the rest of the array is not part of the content
+	inline void pipeline_record_write_vertex_layout(PipelineRecordWriter& writer, const CGPUVertexLayout& vertex_layout)
+	{
+		writer.u32(vertex_layout.attribute_count);
+		for (uint32_t i = 0; i < vertex_layout.attribute_count; ++i)
+		{
+			auto& attribute = vertex_layout.p_attributes[i];
+			auto name_length = strnlen(attribute.semantic_name, sizeof(attribute.semantic_name));
+			writer.u32((uint32_t)name_length);
+			writer.bytes(attribute.semantic_name, name_length);
+			pipeline_record_vertex_attribute(writer, attribute);
+		}
+	}
+
+	inline void pipeline_record_write_blend_state(PipelineRecordWriter& writer, const CGPUBlendStateDescriptor& blend_desc)
+	{
+		writer.u32(blend_desc.attachment_count);
+		writer(blend_desc.alpha_to_coverage);
+		writer(blend_desc.independent_blend);
+		for (uint32_t i = 0; i < blend_desc.attachment_count; ++i)
+			pipeline_record_blend_attachment(writer, blend_desc.p_attachments[i]);
+	}
+
+	inline bool pipeline_record_read_vertex_attribute(PipelineRecordReader& reader, CGPUVertexAttribute& attribute)
+	{
+		attribute = {};
+		auto name_length = reader.u32();
+		if (name_length > sizeof(attribute.semantic_name))
+			return false;
+		auto name = reader.bytes(name_length);
+		if (name)
+			memcpy(attribute.semantic_name, name, name_length);
+		pipeline_record_vertex_attribute(reader, attribute);
+		return !reader.failed;
+	}
+}
@@ -0,0 +1,133 @@
+#include "pipelinestates.h"
+
+#include "pipelinerecord.h"
+#include <cassert>
+#include <limits>
+
+namespace HGEGraphics
+{
+	PipelineStateRegistry::PipelineStateRegistry(std::pmr::memory_resource* const memory_resource)
+		: memory_resource(memory_resource), vertex_layouts(memory_resource), blend_states(memory_resource), depth_states(memory_resource), rasterizer_states(memory_resource)
+		, vertex_layout_ids(memory_resource), blend_state_ids(memory_resource), depth_state_ids(memory_resource), rasterizer_state_ids(memory_resource)
+	{
+		internVertexLayout(CGPUVertexLayout{ .attribute_count = 0 });
+	}
+
+	uint32_t PipelineStateRegistry::internVertexLayout(const CGPUVertexLayout& vertex_layout)
+	{
+		std::pmr::string content(memory_resource);
+		PipelineRecordWriter writer{ content };
+		pipeline_record_write_vertex_layout(writer, vertex_layout);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = vertex_layout_ids.find(content);
+		if (iter != vertex_layout_ids.end())
+			return iter->second;
+
+		auto id = (uint32_t)vertex_layouts.size();
+		auto& entry = vertex_layouts.emplace_back(VertexLayoutEntry{ .vertex_layout = vertex_layout, .vertex_attributes = std::pmr::vector<CGPUVertexAttribute>(memory_resource) });
+		entry.vertex_attributes.assign(vertex_layout.p_attributes, vertex_layout.p_attributes + vertex_layout.attribute_count);
+		entry.vertex_layout.p_attributes = entry.vertex_attributes.data();
+		vertex_layout_ids.emplace(std::move(content), id);
+		return id;
+	}
+
+	uint16_t PipelineStateRegistry::internBlendState(const CGPUBlendStateDescriptor& blend_desc)
+	{
+		std::pmr::string content(memory_resource);
+		PipelineRecordWriter writer{ content };
+		pipeline_record_write_blend_state(writer, blend_desc);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = blend_state_ids.find(content);
+		if (iter != blend_state_ids.end())
+			return iter->second;
+
+		assert(blend_states.size() < std::numeric_limits<uint16_t>::max());
+		auto id = (uint16_t)blend_states.size();
+		auto& entry = blend_states.emplace_back(BlendStateEntry{ .blend_desc = blend_desc, .blend_attachment_states = std::pmr::vector<CGPUBlendAttachmentState>(memory_resource) });
+		entry.blend_attachment_states.assign(blend_desc.p_attachments, blend_desc.p_attachments + blend_desc.attachment_count);
+		entry.blend_desc.p_attachments = entry.blend_attachment_states.data();
+		blend_state_ids.emplace(std::move(content), id);
+		return id;
+	}
+
+	uint16_t PipelineStateRegistry::internDepthState(const CGPUDepthStateDescriptor& depth_desc)
+	{
+		std::pmr::string content(memory_resource);
+		PipelineRecordWriter writer{ content };
+		pipeline_record_depth_state(writer, depth_desc);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = depth_state_ids.find(content);
+		if (iter != depth_state_ids.end())
+			return iter->second;
+
+		assert(depth_states.size() < std::numeric_limits<uint16_t>::max());
+		auto id = (uint16_t)depth_states.size();
+		depth_states.push_back(depth_desc);
+		depth_state_ids.emplace(std::move(content), id);
+		return id;
+	}
+
+	uint16_t PipelineStateRegistry::internRasterizerState(const CGPURasterizerStateDescriptor& rasterizer_state)
+	{
+		std::pmr::string content(memory_resource);
+		PipelineRecordWriter writer{ content };
+		pipeline_record_rasterizer_state(writer, rasterizer_state);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto iter = rasterizer_state_ids.find(content);
+		if (iter != rasterizer_state_ids.end())
+			return iter->second;
+
+		assert(rasterizer_states.size() < std::numeric_limits<uint16_t>::max());
+		auto id = (uint16_t)rasterizer_states.size();
+		rasterizer_states.push_back(rasterizer_state);
+		rasterizer_state_ids.emplace(std::move(content), id);
+		return id;
+	}
+
+	const CGPUVertexLayout& PipelineStateRegistry::vertexLayout(uint32_t id) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(id < vertex_layouts.size());
+		return vertex_layouts[id].vertex_layout;
+	}
+
+	const CGPUBlendStateDescriptor& PipelineStateRegistry::blendState(uint16_t id) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(id < blend_states.size());
+		return blend_states[id].blend_desc;
+	}
+
+	const CGPUDepthStateDescriptor& PipelineStateRegistry::depthState(uint16_t id) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(id < depth_states.size());
+		return depth_states[id];
+	}
+
+	const CGPURasterizerStateDescriptor& PipelineStateRegistry::rasterizerState(uint16_t id) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(id < rasterizer_states.size());
+		return rasterizer_states[id];
+	}
+
+	PipelineStateRegistry& pipeline_state_registry()
+	{
+		static PipelineStateRegistry registry(std::pmr::get_default_resource());
+		return registry;
+	}
+
+	void strip_dynamic_states_t1(CGPUDepthStateDescriptor& depth_desc, CGPURasterizerStateDescriptor& rasterizer_state)
+	{
+		rasterizer_state.cull_mode = (ECGPUCullModeFlags)0;
+		rasterizer_state.front_face = (ECGPUFrontFace)0;
+		depth_desc.depth_test = false;
+		depth_desc.depth_write = false;
+		depth_desc.depth_op = (ECGPUCompareOp)0;
+	}
+}
@@ -51,22 +51,35 @@ namespace HGEGraphics
 	}
 	void Profiler::OnBeginFrame(CGPUCommandBufferId cmd)
 	{
-		labels.clear();
-		cgpu_command_buffer_reset_query_pool(cmd, query_pool, 0, MaxValuesPerFrame);
+		ClearTimeStamps();
+		ResetQueries(cmd);
 		GetTimeStamp(cmd, "Begin Frame");
 	}
 	void Profiler::GetTimeStamp(CGPUCommandBufferId cmd, const char* label)
 	{
-		uint32_t measurements = (uint32_t)labels.size();
-		uint32_t offset = measurements;
-
+		WriteTimeStamp(cmd, ReserveTimeStamp(label));
+	}
+	void Profiler::ClearTimeStamps()
+	{
+		labels.clear();
+	}
+	uint32_t Profiler::ReserveTimeStamp(const char* label)
+	{
+		uint32_t offset = (uint32_t)labels.size();
+		labels.push_back(label);
+		return offset;
+	}
+	void Profiler::ResetQueries(CGPUCommandBufferId cmd)
+	{
+		cgpu_command_buffer_reset_query_pool(cmd, query_pool, 0, MaxValuesPerFrame);
+	}
+	void Profiler::WriteTimeStamp(CGPUCommandBufferId cmd, uint32_t index)
+	{
 		CGPUQueryDescriptor query_desc = {
-			.index = offset,
+			.index = index,
 			.stage = CGPU_SHADER_STAGE_ALL_GRAPHICS,
 		};
 		cgpu_command_buffer_begin_query(cmd, query_pool, &query_desc);
-
-		labels.push_back(label);
 	}
 	void Profiler::OnEndFrame(CGPUCommandBufferId cmd)
 	{
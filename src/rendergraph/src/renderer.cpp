@@ -6,9 +6,43 @@
 #include <bit>
 #include "drawer.h"
 #include "compare.h"
+#include "pipelinestates.h"
+#include <taskflow/taskflow.hpp>
 
 namespace HGEGraphics
 {
+	BindingPlan make_binding_plan(CGPURootSignatureId root_sig)
+	{
+		BindingPlan plan;
+		for (uint32_t i = 0; i < std::min(GlobalBindingTable::max_sets, root_sig->table_count); ++i)
+		{
+			auto& table = root_sig->p_tables[i];
+			assert(table.set_index < GlobalBindingTable::max_sets);
+			BindingPlan::Set set =
+			{
+				.set_index = table.set_index,
+				.used = 0,
+				.first_entry = (uint32_t)plan.entries.size(),
+				.entry_count = 0,
+			};
+			for (uint32_t j = 0; j < std::min(GlobalBindingTable::max_bindings, table.resources_count); ++j)
+			{
+				auto& res = table.p_resources[j];
+				// the kinds the global binding table holds
+				if (res.type != CGPU_RESOURCE_TYPE_TEXTURE && res.type != CGPU_RESOURCE_TYPE_RW_TEXTURE && res.type != CGPU_RESOURCE_TYPE_SAMPLER
+					&& res.type != CGPU_RESOURCE_TYPE_UNIFORM_BUFFER && res.type != CGPU_RESOURCE_TYPE_BUFFER && res.type != CGPU_RESOURCE_TYPE_RW_BUFFER)
+					continue;
+				plan.entries.push_back({ .binding = res.binding, .type = res.type, .array_count = std::max(res.size, 1u) });
+				if (res.binding < GlobalBindingTable::max_bindings)
+					set.used |= 1ull << res.binding;
+				++set.entry_count;
+			}
+			if (set.entry_count > 0)
+				plan.sets.push_back(set);
+		}
+		return plan;
+	}
+
 	std::unique_ptr<Shader> create_shader(CGPUDeviceId device, const uint8_t* vert_data, uint32_t vert_length, const uint8_t* frag_data, uint32_t frag_length, const CGPUBlendStateDescriptor& blend_desc, const CGPUDepthStateDescriptor& depth_desc, const CGPURasterizerStateDescriptor& rasterizer_state)
 	{
 		CGPUShaderLibraryDescriptor vs_desc = {
@@ -40,6 +74,7 @@ namespace HGEGraphics
 
 		auto shader = new Shader();
 		shader->root_sig = root_sig;
+		shader->binding_plan = make_binding_plan(root_sig);
 		shader->vs = ppl_shaders[0];
 		shader->ps = ppl_shaders[1];
 		shader->blend_desc = blend_desc;
@@ -48,6 +83,16 @@ namespace HGEGraphics
 		shader->blend_desc.p_attachments = shader->blend_attachment_states.data();
 		shader->depth_desc = depth_desc;
 		shader->rasterizer_state = rasterizer_state;
+		auto& registry = pipeline_state_registry();
+		shader->blend_state_id = registry.internBlendState(shader->blend_desc);
+		shader->depth_state_id = registry.internDepthState(depth_desc);
+		shader->rasterizer_state_id = registry.internRasterizerState(rasterizer_state);
+		auto dynamic_depth_desc = depth_desc;
+		auto dynamic_rasterizer_state = rasterizer_state;
+		strip_dynamic_states_t1(dynamic_depth_desc, dynamic_rasterizer_state);
+		shader->dynamic_depth_state_id = registry.internDepthState(dynamic_depth_desc);
+		shader->dynamic_rasterizer_state_id = registry.internRasterizerState(dynamic_rasterizer_state);
+		shader->content_hash = fnv1a64(frag_data, frag_length, fnv1a64(vert_data, vert_length));
 		return std::unique_ptr<Shader>(shader);
 	}
 
@@ -80,7 +125,9 @@ namespace HGEGraphics
 
 		auto shader = new ComputeShader();
 		shader->root_sig = root_sig;
+		shader->binding_plan = make_binding_plan(root_sig);
 		shader->cs = ppl_shaders[0];
+		shader->content_hash = fnv1a64(comp_data, comp_length);
 		return std::unique_ptr<ComputeShader>(shader);
 	}
 
@@ -118,6 +165,7 @@ namespace HGEGraphics
 	{
 		auto mesh = new Mesh();
 		mesh->vertex_layout = {};
+		mesh->vertex_layout_id = 0;
 		mesh->prim_topology = CGPU_PRIMITIVE_TOPOLOGY_POINT_LIST;
 		mesh->vertices_count = 0;
 		mesh->index_count = 0;
@@ -134,6 +182,7 @@ namespace HGEGraphics
 		mesh->vertex_attributes.resize(vertex_layout.attribute_count);
 		std::copy(vertex_layout.p_attributes, vertex_layout.p_attributes + vertex_layout.attribute_count, mesh->vertex_attributes.begin());
 		mesh->vertex_layout.p_attributes = mesh->vertex_attributes.data();
+		mesh->vertex_layout_id = pipeline_state_registry().internVertexLayout(vertex_layout);
 		mesh->prim_topology = prim_topology;
 		mesh->vertices_count = vertex_count;
 		mesh->index_count = index_count;
@@ -178,6 +227,7 @@ namespace HGEGraphics
 		mesh->vertex_attributes.resize(vertex_layout.attribute_count);
 		std::copy(vertex_layout.p_attributes, vertex_layout.p_attributes + vertex_layout.attribute_count, mesh->vertex_attributes.begin());
 		mesh->vertex_layout.p_attributes = mesh->vertex_attributes.data();
+		mesh->vertex_layout_id = pipeline_state_registry().internVertexLayout(vertex_layout);
 		mesh->prim_topology = prim_topology;
 		mesh->vertices_count = 0;
 		mesh->vertex_stride = 0;
@@ -228,7 +278,6 @@ namespace HGEGraphics
 		texture->handle = CGPU_NULLPTR;
 		texture->view = CGPU_NULLPTR;
 		texture->cur_states.clear();
-		texture->states_consistent = false;
 		texture->prepared = false;
 		texture->dynamic_handle = {};
 		return std::unique_ptr<Texture>(texture);
@@ -241,9 +290,7 @@ namespace HGEGraphics
 			new_desc.flags |= CGPU_TEXTURE_CREATION_USAGE_FORCE2D;
 
 		texture->handle = cgpu_device_create_texture(device, &new_desc);
-		texture->cur_states.resize(new_desc.array_size * new_desc.mip_levels);
-		std::fill(texture->cur_states.begin(), texture->cur_states.end(), CGPU_RESOURCE_STATE_UNDEFINED);
-		texture->states_consistent = true;
+		texture->cur_states.reset(new_desc.mip_levels, new_desc.array_size, CGPU_RESOURCE_STATE_UNDEFINED);
 
 		uint32_t arrayCount = texture->handle->info->array_size_minus_one + 1;
 		ECGPUTextureDimension dims = CGPU_TEXTURE_DIMENSION_2D;
@@ -326,9 +373,7 @@ namespace HGEGraphics
 	{
 		backbuffer->texture.handle = swapchain->back_buffers[index];
 		backbuffer->texture.view = CGPU_NULLPTR;
-		backbuffer->texture.cur_states.resize(1);
-		backbuffer->texture.cur_states[0] = CGPU_RESOURCE_STATE_UNDEFINED;
-		backbuffer->texture.states_consistent = true;
+		backbuffer->texture.cur_states.reset(1, 1, CGPU_RESOURCE_STATE_UNDEFINED);
 		backbuffer->texture.dynamic_handle = {};
 	}
 
@@ -337,7 +382,6 @@ namespace HGEGraphics
 		texture.handle = CGPU_NULLPTR;
 		texture.view = CGPU_NULLPTR;
 		texture.cur_states.clear();
-		texture.states_consistent = false;
 	}
 
 	void set_viewport(RenderPassEncoder* encoder, float x, float y, float width, float height, float min_depth, float max_depth)
@@ -355,10 +399,50 @@ namespace HGEGraphics
 		cgpu_render_pass_encoder_push_constants(encoder->encoder, shader->root_sig, name, data);
 	}
 
-	void update_render_pipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology mesh_topology, const CGPUVertexLayout& vertex_layout)
+	uint32_t push_constant_index(const Shader* shader, const char* name)
+	{
+		auto root_sig = shader->root_sig;
+		for (uint32_t i = 0; i < root_sig->push_constant_count; ++i)
+		{
+			if (strcmp(root_sig->push_constants[i].name, name) == 0)
+				return i;
+		}
+		assert(false && "no push constant of that name");
+		return 0;
+	}
+
+	void push_constants(RenderPassEncoder* encoder, Shader* shader, uint32_t index, const void* data)
+	{
+		assert(index < shader->root_sig->push_constant_count);
+		// cgpu takes the range by name, the reflected one is passed along
+		cgpu_render_pass_encoder_push_constants(encoder->encoder, shader->root_sig, shader->root_sig->push_constants[index].name, data);
+	}
+
+	GraphicsPipeline* find_graphics_pipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology mesh_topology, uint32_t vertex_layout)
 	{
-		auto pipeline = encoder->context->pipelinePool.getGraphicsPipeline(encoder, shader, mesh_topology, vertex_layout);
-		if (pipeline && pipeline->handle != encoder->last_render_pipeline)
+		auto& pipelines = encoder->recorder->graphics_pipelines;
+		auto key = encoder->context->pipelinePool.pipelineKey(encoder, shader, mesh_topology, vertex_layout);
+		auto iter = pipelines.find(key);
+		if (iter != pipelines.end())
+			return iter->second;
+		auto pipeline = encoder->context->pipelinePool.getGraphicsPipeline(key, *encoder->context->pipeline_mutex);
+		pipelines.emplace(key, pipeline);
+		return pipeline;
+	}
+
+	// binds the pipeline of the shader, or the one of its fallback while the shader's own pipeline still compiles. returns
+	// the shader whose pipeline is bound, nullptr when none is ready and the draw has to be skipped
+	Shader* update_render_pipeline(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology mesh_topology, uint32_t vertex_layout)
+	{
+		GraphicsPipeline* pipeline = find_graphics_pipeline(encoder, shader, mesh_topology, vertex_layout);
+		if (!pipeline->ready.load(std::memory_order_acquire) && shader->fallback)
+		{
+			shader = shader->fallback;
+			pipeline = find_graphics_pipeline(encoder, shader, mesh_topology, vertex_layout);
+		}
+		if (!pipeline->ready.load(std::memory_order_acquire))
+			return nullptr;
+		if (pipeline->handle != encoder->last_render_pipeline)
 		{
 			cgpu_render_pass_encoder_bind_render_pipeline(encoder->encoder, pipeline->handle);
 			if (encoder->context->pipelinePool.dynamicStateT1Enabled())
@@ -371,127 +455,131 @@ namespace HGEGraphics
 				cgpu_raster_state_encoder_set_depth_compare_op(encoder->raster_state_encoder, shader->depth_desc.depth_op);
 			}
 			encoder->last_render_pipeline = pipeline->handle;
-			memset(encoder->last_bind_resources, 0, sizeof(encoder->last_bind_resources));
 		}
+		return shader;
 	}
 
-	void update_descriptor_set(RenderPassEncoder* encoder, CGPURootSignatureId root_sig, bool is_graphics)
+	void update_descriptor_set(RenderPassEncoder* encoder, CGPURootSignatureId root_sig, const BindingPlan& plan, bool is_graphics)
 	{
-		for (uint32_t i = 0; i < std::min(4u, root_sig->table_count); ++i)
+		auto& bindings = encoder->recorder->global_bindings;
+		auto& tracker = encoder->descriptor_sets;
+		// sets stay bound across pipelines of one root signature
+		if (tracker.root_signature != root_sig)
+			tracker.reset(root_sig);
+		for (auto& plan_set : plan.sets)
 		{
-			auto& table = root_sig->p_tables[i];
-			CGPUDescriptorSetDescriptor dset_desc =
-			{
-				.root_signature = root_sig,
-				.set_index = table.set_index,
-			};
-			
-			auto dset = encoder->context->descriptorSetPool.getDescriptorSet(dset_desc);
-			encoder->context->allocated_dsets.push_back(dset);
-
-			const uint32_t data_size = 64;
-			CGPUDescriptorData datas[data_size] = { 0 };
+			auto set = plan_set.set_index;
+			// nothing the shader reads from the set changed since it was last written
+			if (tracker.bound(set) && (bindings.dirty[set] & plan_set.used) == 0)
+				continue;
+			bindings.dirty[set] = 0;
+
+			const uint32_t data_size = GlobalBindingTable::max_bindings;
+			CGPUDescriptorData datas[data_size];
+			CGPUTextureViewId textureviews[data_size];
+			CGPUSamplerId samplers[data_size];
+			CGPUBufferId buffers[data_size];
+			uint64_t offset_sizes[data_size * 2];
+			// what the bindings resolve to, in table order
+			uint64_t words[data_size * 3];
 			uint32_t data_count = 0;
-			uint32_t texture_view_count = 0;
-			uint32_t sampler_count = 0;
-			uint32_t buffer_count = 0;
+			uint32_t word_count = 0;
 			uint32_t offset_size_count = 0;
-			for (uint32_t j = 0; j < std::min(data_size, table.resources_count); ++j)
+			for (uint32_t j = 0; j < plan_set.entry_count; ++j)
 			{
-				auto& res = table.p_resources[j];
-				CGPUDescriptorData data =
+				auto& res = plan.entries[plan_set.first_entry + j];
+				CGPUDescriptorData& data = datas[data_count];
+				data =
 				{
 					.binding = res.binding,
 					.binding_type = res.type,
 					.count = 1,
 				};
-				if (res.type == CGPU_RESOURCE_TYPE_TEXTURE)
+				if (res.type == CGPU_RESOURCE_TYPE_TEXTURE || res.type == CGPU_RESOURCE_TYPE_RW_TEXTURE)
 				{
+					auto usage = res.type == CGPU_RESOURCE_TYPE_RW_TEXTURE ? CGPU_TEXTURE_VIEW_USAGE_UAV : CGPU_TEXTURE_VIEW_USAGE_SRV;
 					CGPUTextureViewId textureview = CGPU_NULLPTR;
-					for (auto iter = encoder->context->global_texture_table.rbegin(); iter != encoder->context->global_texture_table.rend(); ++iter)
+					if (auto binder = bindings.texture(set, res.binding))
 					{
-						auto& binder = *iter;
-						if (binder.set == i && binder.bind == res.binding)
-						{
-							if (rendergraph_texture_handle_valid(binder.texture_handle))
-								textureview = rendergraph_resolve_texture_view(encoder, binder.texture_handle);
-							else if (binder.texture && binder.texture->prepared)
-								textureview = binder.texture->view;
-							break;
-						}
+						if (rendergraph_texture_handle_valid(binder->texture_handle))
+							textureview = rendergraph_resolve_texture_view(encoder, binder->texture_handle, usage);
+						else if (binder->texture && binder->texture->prepared)
+							textureview = binder->texture->view;
 					}
 					if (!textureview)
 						textureview = encoder->context->default_texture;
-					encoder->textureviews[texture_view_count] = textureview;
-					data.resources.textures = encoder->textureviews + texture_view_count;
-					++texture_view_count;
+					textureviews[data_count] = textureview;
+					data.resources.textures = textureviews + data_count;
+					words[word_count++] = (uint64_t)textureview;
 				}
 				else if (res.type == CGPU_RESOURCE_TYPE_SAMPLER)
 				{
 					CGPUSamplerId sampler = CGPU_NULLPTR;
-					for (auto iter = encoder->context->global_sampler_table.rbegin(); iter != encoder->context->global_sampler_table.rend(); ++iter)
-					{
-						auto& binder = *iter;
-						if (binder.set == i && binder.bind == res.binding)
-						{
-							sampler = binder.sampler;
-							break;
-						}
-					}
+					if (auto binder = bindings.sampler(set, res.binding))
+						sampler = binder->sampler;
 					if (!sampler)
 						;	// TODO
-					encoder->samplers[sampler_count] = sampler;
-					data.resources.samplers = encoder->samplers + sampler_count;
-					++sampler_count;
+					samplers[data_count] = sampler;
+					data.resources.samplers = samplers + data_count;
+					words[word_count++] = (uint64_t)sampler;
 				}
-				else if (res.type == CGPU_RESOURCE_TYPE_UNIFORM_BUFFER || res.type == CGPU_RESOURCE_TYPE_RW_BUFFER)
+				else if (res.type == CGPU_RESOURCE_TYPE_UNIFORM_BUFFER || res.type == CGPU_RESOURCE_TYPE_BUFFER || res.type == CGPU_RESOURCE_TYPE_RW_BUFFER)
 				{
-					for (auto iter = encoder->context->global_buffer_table.rbegin(); iter != encoder->context->global_buffer_table.rend(); ++iter)
+					if (auto binder = bindings.buffer(set, res.binding))
 					{
-						auto& binder = *iter;
-						if (binder.set == i && binder.bind == res.binding)
+						CGPUBufferId buffer;
+						if (rendergraph_buffer_handle_valid(binder->buffer_handle))
+							buffer = rendergraph_resolve_buffer(encoder, binder->buffer_handle);
+						else
+							buffer = binder->buffer->handle;
+						buffers[data_count] = buffer;
+						if (binder->offset != 0 || binder->size != 0)
 						{
-							CGPUBufferId buffer;
-							if (rendergraph_buffer_handle_valid(binder.buffer_handle))
-								buffer = rendergraph_resolve_buffer(encoder, binder.buffer_handle);
-							else
-								buffer = binder.buffer->handle;
-							encoder->buffers[buffer_count] = buffer;
-							if (binder.offset != 0 || binder.size != 0)
-							{
-								encoder->buffer_offset_sizes[offset_size_count] = binder.offset;
-								data.params.buffers_params.offsets = encoder->buffer_offset_sizes + (offset_size_count++);
-								encoder->buffer_offset_sizes[offset_size_count] = binder.size;
-								data.params.buffers_params.sizes = encoder->buffer_offset_sizes + (offset_size_count++);
-							}
-							data.resources.buffers = encoder->buffers + buffer_count;
-							++buffer_count;
-							break;
+							offset_sizes[offset_size_count] = binder->offset;
+							data.params.buffers_params.offsets = offset_sizes + (offset_size_count++);
+							offset_sizes[offset_size_count] = binder->size;
+							data.params.buffers_params.sizes = offset_sizes + (offset_size_count++);
 						}
+						data.resources.buffers = buffers + data_count;
+						words[word_count++] = (uint64_t)buffer;
+						words[word_count++] = binder->offset;
+						words[word_count++] = binder->size;
 					}
+					else
+						words[word_count++] = 0;
 				}
 				if (data.resources.ptrs != nullptr)
-					datas[data_count++] = data;
+					++data_count;
 			}
 
-			if (data_count > 0)
+			// a changed slot can still resolve to what the bound set holds
+			if (data_count > 0 && !tracker.matches(set, words, word_count))
 			{
-				bool dset_dirty = !compare(datas, encoder->last_bind_resources[i], data_count);
-				bool offset_size_dirty = memcmp(encoder->buffer_offset_sizes, encoder->last_buffer_offset_sizes[i], sizeof(float) * 2 * offset_size_count);
-				if (dset_dirty || offset_size_dirty)
-				{
-					cgpu_descriptor_set_update(dset->handle, data_count, datas);
-					if (is_graphics)
-						cgpu_render_pass_encoder_bind_descriptor_set(encoder->encoder, dset->handle);
-					else
-						cgpu_compute_pass_encoder_bind_descriptor_set(encoder->compute_encoder, dset->handle);
-					memcpy(encoder->last_bind_resources[i], datas, sizeof(CGPUDescriptorData) * data_count);
-					memcpy(encoder->last_buffer_offset_sizes[i], encoder->buffer_offset_sizes, sizeof(float) * 2 * offset_size_count);
-				}
+				// only the recording thread owning the recorder takes sets from its arenas
+				auto dset = encoder->recorder->descriptorSets.acquire(root_sig, set);
+				cgpu_descriptor_set_update(dset, data_count, datas);
+				if (is_graphics)
+					cgpu_render_pass_encoder_bind_descriptor_set(encoder->encoder, dset);
+				else
+					cgpu_compute_pass_encoder_bind_descriptor_set(encoder->compute_encoder, dset);
 			}
 		}
 	}
 
+	bool DescriptorSetTracker::matches(uint32_t set, const uint64_t* set_words, uint32_t count)
+	{
+		assert(set < max_sets);
+		uint8_t bit = 1u << set;
+		if ((bound_sets & bit) && count <= inline_words && word_counts[set] == count && memcmp(words[set], set_words, sizeof(uint64_t) * count) == 0)
+			return true;
+		bound_sets |= bit;
+		// too many to keep, the set is written whenever it's dirty
+		word_counts[set] = count <= inline_words ? count : UINT8_MAX;
+		if (count <= inline_words)
+			memcpy(words[set], set_words, sizeof(uint64_t) * count);
+		return false;
+	}
+
 	void update_material(RenderPassEncoder* encoder, Material* material)
 	{
 		for (auto& bind : material->buffers)
@@ -550,8 +638,10 @@ namespace HGEGraphics
 	{
 		if (!mesh->prepared)
 			return;
-		update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout);
-		update_descriptor_set(encoder, shader->root_sig, true);
+		shader = update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout_id);
+		if (!shader)
+			return;
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, true);
 		update_mesh(encoder, mesh);
 		if (encoder->last_index_buffer)
 			cgpu_render_pass_encoder_draw_indexed(encoder->encoder, mesh->index_count, 0, 0);
@@ -563,8 +653,10 @@ namespace HGEGraphics
 	{
 		if (!mesh->prepared)
 			return;
-		update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout);
-		update_descriptor_set(encoder, shader->root_sig, true);
+		shader = update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout_id);
+		if (!shader)
+			return;
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, true);
 		update_mesh(encoder, mesh);
 		if (encoder->last_index_buffer)
 			cgpu_render_pass_encoder_draw_indexed(encoder->encoder, index_count, first_index, first_vertex);
@@ -572,11 +664,14 @@ namespace HGEGraphics
 			cgpu_render_pass_encoder_draw(encoder->encoder, vertex_count, first_vertex);
 	}
 
-	static CGPUVertexLayout procedure_vertex_layout = { .attribute_count = 0 };
+	// the layout without attributes is always interned first
+	static const uint32_t procedure_vertex_layout = 0;
 	void draw_procedure(RenderPassEncoder* encoder, Shader* shader, ECGPUPrimitiveTopology mesh_topology, uint32_t vertex_count)
 	{
-		update_render_pipeline(encoder, shader, mesh_topology, procedure_vertex_layout);
-		update_descriptor_set(encoder, shader->root_sig, true);
+		shader = update_render_pipeline(encoder, shader, mesh_topology, procedure_vertex_layout);
+		if (!shader)
+			return;
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, true);
 		cgpu_render_pass_encoder_draw(encoder->encoder, vertex_count, 0);
 	}
 
@@ -586,8 +681,10 @@ namespace HGEGraphics
 			return;
 		update_material(encoder, material);
 		auto shader = material->shader;
-		update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout);
-		update_descriptor_set(encoder, shader->root_sig, true);
+		shader = update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout_id);
+		if (!shader)
+			return;
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, true);
 		update_mesh(encoder, mesh);
 		if (encoder->last_index_buffer)
 			cgpu_render_pass_encoder_draw_indexed(encoder->encoder, mesh->index_count, 0, 0);
@@ -601,8 +698,10 @@ namespace HGEGraphics
 			return;
 		update_material(encoder, material);
 		auto shader = material->shader;
-		update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout);
-		update_descriptor_set(encoder, shader->root_sig, true);
+		shader = update_render_pipeline(encoder, shader, mesh->prim_topology, mesh->vertex_layout_id);
+		if (!shader)
+			return;
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, true);
 		update_mesh(encoder, mesh);
 		if (encoder->last_index_buffer)
 			cgpu_render_pass_encoder_draw_indexed(encoder->encoder, index_count, first_index, first_vertex);
@@ -614,57 +713,67 @@ namespace HGEGraphics
 	{
 		update_material(encoder, material);
 		auto shader = material->shader;
-		update_render_pipeline(encoder, shader, mesh_topology, procedure_vertex_layout);
-		update_descriptor_set(encoder, shader->root_sig, true);
+		shader = update_render_pipeline(encoder, shader, mesh_topology, procedure_vertex_layout);
+		if (!shader)
+			return;
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, true);
 		cgpu_render_pass_encoder_draw(encoder->encoder, vertex_count, 0);
 	}
 
 	void update_compute_pipeline(RenderPassEncoder* encoder, ComputeShader* shader)
 	{
-		auto pipeline = encoder->context->computePipelinePool.getComputePipeline(shader);
+		auto& pipelines = encoder->recorder->compute_pipelines;
+		ComputePipeline* pipeline;
+		auto iter = pipelines.find(shader);
+		if (iter != pipelines.end())
+			pipeline = iter->second;
+		else
+		{
+			pipeline = encoder->context->computePipelinePool.getComputePipeline(shader, *encoder->context->pipeline_mutex);
+			pipelines.emplace(shader, pipeline);
+		}
 		if (pipeline && pipeline->handle != encoder->last_compute_pipeline)
 		{
 			cgpu_compute_pass_encoder_bind_compute_pipeline(encoder->compute_encoder, pipeline->handle);
 			encoder->last_compute_pipeline = pipeline->handle;
-			memset(encoder->last_bind_resources, 0, sizeof(encoder->last_bind_resources));
 		}
 	}
 
 	void dispatch(RenderPassEncoder* encoder, ComputeShader* shader, uint32_t thread_x, uint32_t thread_y, uint32_t thread_z)
 	{
 		update_compute_pipeline(encoder, shader);
-		update_descriptor_set(encoder, shader->root_sig, false);
+		update_descriptor_set(encoder, shader->root_sig, shader->binding_plan, false);
 		cgpu_compute_pass_encoder_dispatch(encoder->compute_encoder, thread_x, thread_y, thread_z);
 	}
 
 	void set_global_texture(RenderPassEncoder* encoder, Texture* texture, int set, int slot)
 	{
-		encoder->context->global_texture_table.push_back({ texture, {}, set, slot });
+		encoder->recorder->global_bindings.setTexture({ texture, {}, set, slot });
 	}
 
 	void set_global_texture_handle(RenderPassEncoder* encoder, texture_handle_t texture, int set, int slot)
 	{
-		encoder->context->global_texture_table.push_back({ nullptr, texture, set, slot });
+		encoder->recorder->global_bindings.setTexture({ nullptr, texture, set, slot });
 	}
 
 	void set_global_sampler(RenderPassEncoder* encoder, CGPUSamplerId sampler, int set, int slot)
 	{
-		encoder->context->global_sampler_table.push_back({ sampler, set, slot });
+		encoder->recorder->global_bindings.setSampler({ sampler, set, slot });
 	}
 
 	void set_global_buffer(RenderPassEncoder* encoder, Buffer* buffer, int set, int slot)
 	{
-		encoder->context->global_buffer_table.push_back({ buffer, {}, set, slot, 0, 0 });
+		encoder->recorder->global_bindings.setBuffer({ buffer, {}, set, slot, 0, 0 });
 	}
 
 	void set_global_dynamic_buffer(RenderPassEncoder* encoder, buffer_handle_t buffer, int set, int slot)
 	{
-		encoder->context->global_buffer_table.push_back({ nullptr, buffer, set, slot, 0, 0 });
+		encoder->recorder->global_bindings.setBuffer({ nullptr, buffer, set, slot, 0, 0 });
 	}
 
 	void set_global_buffer_with_offset_size(RenderPassEncoder* encoder, buffer_handle_t buffer, int set, int slot, uint64_t offset, uint64_t size)
 	{
-		encoder->context->global_buffer_table.push_back({ nullptr, buffer, set, slot, offset, size });
+		encoder->recorder->global_bindings.setBuffer({ nullptr, buffer, set, slot, offset, size });
 	}
 
 	void upload(UploadEncoder* encoder, uint64_t offset, uint64_t length, void* data)
@@ -673,11 +782,267 @@ namespace HGEGraphics
 		memcpy(address, data, length);
 	}
 
-	ExecutorContext::ExecutorContext(CGPUDeviceId device, CGPUQueueId gfx_queue, bool profile, std::pmr::memory_resource* memory_resource)
-		: device(device), memory_resource(memory_resource), renderPassPool(device, memory_resource), framebufferPool(device, memory_resource), texturePool(device, gfx_queue, nullptr, memory_resource), pipelinePool(device, nullptr, memory_resource), computePipelinePool(device, nullptr, memory_resource), textureViewPool(nullptr, memory_resource), bufferPool(device, nullptr, memory_resource), descriptorSetPool(device, memory_resource), allocated_dsets(memory_resource)
-		, cmds(memory_resource), allocated_cmds(memory_resource), global_texture_table(memory_resource), global_sampler_table(memory_resource), global_buffer_table(memory_resource)
+	void GlobalBindingTable::setTexture(const ShaderTextureBinder& binder)
+	{
+		assert(binder.set >= 0 && binder.set < max_sets && binder.bind >= 0 && binder.bind < max_bindings);
+		auto& slot = textures[binder.set][binder.bind];
+		auto bit = 1ull << binder.bind;
+		if ((texture_mask[binder.set] & bit) && slot.texture == binder.texture && slot.texture_handle.index == binder.texture_handle.index)
+			return;
+		slot = binder;
+		texture_mask[binder.set] |= bit;
+		dirty[binder.set] |= bit;
+	}
+
+	void GlobalBindingTable::setSampler(const ShaderSamplerBinder& binder)
+	{
+		assert(binder.set >= 0 && binder.set < max_sets && binder.bind >= 0 && binder.bind < max_bindings);
+		auto& slot = samplers[binder.set][binder.bind];
+		auto bit = 1ull << binder.bind;
+		if ((sampler_mask[binder.set] & bit) && slot.sampler == binder.sampler)
+			return;
+		slot = binder;
+		sampler_mask[binder.set] |= bit;
+		dirty[binder.set] |= bit;
+	}
+
+	void GlobalBindingTable::setBuffer(const ShaderBufferBinder& binder)
+	{
+		assert(binder.set >= 0 && binder.set < max_sets && binder.bind >= 0 && binder.bind < max_bindings);
+		auto& slot = buffers[binder.set][binder.bind];
+		auto bit = 1ull << binder.bind;
+		if ((buffer_mask[binder.set] & bit) && slot.buffer == binder.buffer && slot.buffer_handle.index == binder.buffer_handle.index && slot.offset == binder.offset && slot.size == binder.size)
+			return;
+		slot = binder;
+		buffer_mask[binder.set] |= bit;
+		dirty[binder.set] |= bit;
+	}
+
+	void GlobalBindingTable::clear()
+	{
+		std::fill(std::begin(texture_mask), std::end(texture_mask), 0);
+		std::fill(std::begin(sampler_mask), std::end(sampler_mask), 0);
+		std::fill(std::begin(buffer_mask), std::end(buffer_mask), 0);
+		std::fill(std::begin(dirty), std::end(dirty), ~0ull);
+	}
+
+	CommandRecorder::CommandRecorder(CGPUQueueId gfx_queue, CGPUQueueId compute_queue, std::pmr::memory_resource* memory_resource)
+		: cmds(memory_resource), allocated_cmds(memory_resource), compute_cmds(memory_resource), allocated_compute_cmds(memory_resource)
+		, descriptorSets(gfx_queue->device, memory_resource), graphics_pipelines(memory_resource), compute_pipelines(memory_resource)
 	{
 		cmdPool = cgpu_queue_create_command_pool(gfx_queue, CGPU_NULLPTR);
+		if (compute_queue)
+			computeCmdPool = cgpu_queue_create_command_pool(compute_queue, CGPU_NULLPTR);
+	}
+
+	void CommandRecorder::newFrame()
+	{
+		cgpu_command_pool_reset(cmdPool);
+		descriptorSets.reset();
+		graphics_pipelines.clear();
+		compute_pipelines.clear();
+
+		for (auto cmd : allocated_cmds)
+			cmds.push_back(cmd);
+		allocated_cmds.clear();
+
+		if (computeCmdPool)
+			cgpu_command_pool_reset(computeCmdPool);
+		for (auto cmd : allocated_compute_cmds)
+			compute_cmds.push_back(cmd);
+		allocated_compute_cmds.clear();
+
+		clearBindings();
+	}
+
+	CGPUCommandBufferId CommandRecorder::requestCmd(ECGPUQueueType queue)
+	{
+		auto& free_cmds = queue == CGPU_QUEUE_TYPE_COMPUTE ? compute_cmds : cmds;
+		CGPUCommandBufferId cmd;
+		if (!free_cmds.empty())
+		{
+			cmd = free_cmds.back();
+			free_cmds.pop_back();
+		}
+		else
+		{
+			CGPUCommandBufferDescriptor cmd_desc = { .is_secondary = false };
+			cmd = cgpu_command_pool_create_command_buffer(queue == CGPU_QUEUE_TYPE_COMPUTE ? computeCmdPool : cmdPool, &cmd_desc);
+		}
+
+		(queue == CGPU_QUEUE_TYPE_COMPUTE ? allocated_compute_cmds : allocated_cmds).push_back(cmd);
+		return cmd;
+	}
+
+	void CommandRecorder::clearBindings()
+	{
+		global_bindings.clear();
+	}
+
+	void CommandRecorder::destroy()
+	{
+		for (auto cmd : cmds)
+		{
+			cgpu_command_pool_free_command_buffer(cmdPool, cmd);
+		}
+		cmds.clear();
+		for (auto cmd : allocated_cmds)
+		{
+			cgpu_command_pool_free_command_buffer(cmdPool, cmd);
+		}
+		allocated_cmds.clear();
+		if (cmdPool)
+			cgpu_queue_free_command_pool(cmdPool->queue, cmdPool);
+		cmdPool = CGPU_NULLPTR;
+		for (auto cmd : compute_cmds)
+		{
+			cgpu_command_pool_free_command_buffer(computeCmdPool, cmd);
+		}
+		compute_cmds.clear();
+		for (auto cmd : allocated_compute_cmds)
+		{
+			cgpu_command_pool_free_command_buffer(computeCmdPool, cmd);
+		}
+		allocated_compute_cmds.clear();
+		if (computeCmdPool)
+			cgpu_queue_free_command_pool(computeCmdPool->queue, computeCmdPool);
+		computeCmdPool = CGPU_NULLPTR;
+		descriptorSets.destroy();
+		graphics_pipelines.clear();
+		compute_pipelines.clear();
+		clearBindings();
+	}
+
+	SharedResourcePools::SharedResourcePools(CGPUDeviceId device, CGPUQueueId gfx_queue, uint32_t frames_in_flight, std::pmr::memory_resource* memory_resource)
+		: memory_resource(memory_resource), texturePool(device, gfx_queue, nullptr, memory_resource), bufferPool(device, nullptr, memory_resource), renderPassPool(device, nullptr, memory_resource)
+		, pipelinePool(device, nullptr, memory_resource), computePipelinePool(device, nullptr, memory_resource), pipelineCache(memory_resource)
+	{
+		pipelinePool.setPipelineCache(&pipelineCache);
+		computePipelinePool.setPipelineCache(&pipelineCache);
+		texturePool.setSharedBudget(&transientBudget);
+		bufferPool.setSharedBudget(&transientBudget);
+
+		// these pools age once per frame instead of once per use of a frame context, the views and framebuffers
+		// cached by the contexts must still expire before the textures and render passes they point to
+		texturePool.setFramesBeforeOutOfDate(12 * frames_in_flight);
+		bufferPool.setFramesBeforeOutOfDate(12 * frames_in_flight);
+		renderPassPool.setFramesBeforeOutOfDate(12 * frames_in_flight);
+		pipelinePool.setFramesBeforeOutOfDate(12 * frames_in_flight);
+		computePipelinePool.setFramesBeforeOutOfDate(12 * frames_in_flight);
+	}
+
+	void SharedResourcePools::preparePipelines(const PipelineCache& records, std::span<Shader* const> shaders, tf::Executor* executor)
+	{
+		struct PreparedPipeline
+		{
+			PSOKey key;
+			CGPURenderPipelineId handle;
+		};
+
+		std::pmr::vector<PreparedPipeline> pipelines(memory_resource);
+		{
+			GraphicsPipelineDescription description(memory_resource);
+			std::lock_guard<std::mutex> lock(pipeline_mutex);
+			for (auto shader : shaders)
+			{
+				records.visitGraphicsPipelines(shader->content_hash, [&](const std::pmr::string& record)
+				{
+					if (!PipelineCache::decode(record, description))
+						return;
+					auto render_pass = renderPassPool.getRenderPass(description.render_pass);
+					auto key = pipelinePool.pipelineKey(shader, description, render_pass);
+					if (!pipelinePool.isPrepared(key))
+						pipelines.push_back({ key, CGPU_NULLPTR });
+				});
+			}
+		}
+
+		// creating pipelines touches no pool, only the lookups above and the inserts below need the lock
+		auto compile = [this](PreparedPipeline& pipeline)
+		{
+			pipeline.handle = pipelinePool.createPipeline(pipeline.key);
+		};
+		if (executor && pipelines.size() > 1)
+		{
+			tf::Taskflow taskflow;
+			for (auto& pipeline : pipelines)
+				taskflow.emplace([&compile, &pipeline]() { compile(pipeline); });
+			// a worker of the same executor has to help out instead of blocking on the flow
+			if (executor->this_worker_id() >= 0)
+				executor->corun(taskflow);
+			else
+				executor->run(taskflow).wait();
+		}
+		else
+		{
+			for (auto& pipeline : pipelines)
+				compile(pipeline);
+		}
+
+		std::lock_guard<std::mutex> lock(pipeline_mutex);
+		for (auto& pipeline : pipelines)
+		{
+			if (pipeline.handle)
+				pipelinePool.addPreparedPipeline(pipeline.key, pipeline.handle);
+		}
+	}
+
+	void SharedResourcePools::preparePipelines(const PipelineCache& records, std::span<ComputeShader* const> shaders)
+	{
+		std::lock_guard<std::mutex> lock(pipeline_mutex);
+		for (auto shader : shaders)
+		{
+			if (records.hasComputePipeline(shader->content_hash))
+				computePipelinePool.getComputePipeline(shader);
+		}
+	}
+
+	void SharedResourcePools::preparePipelines(Shader* shader)
+	{
+		preparePipelines(pipelineCache, std::span<Shader* const>(&shader, 1));
+	}
+
+	void SharedResourcePools::preparePipelines(ComputeShader* shader)
+	{
+		preparePipelines(pipelineCache, std::span<ComputeShader* const>(&shader, 1));
+	}
+
+	void SharedResourcePools::newFrame()
+	{
+		texturePool.newFrame();
+		bufferPool.newFrame();
+		// both pools age together, so their timestamps tell which idle resource was used least recently
+		while (transientBudget.limit_bytes && transientBudget.current_bytes > transientBudget.limit_bytes)
+		{
+			auto texture_timestamp = texturePool.oldestIdleTimestamp();
+			auto buffer_timestamp = bufferPool.oldestIdleTimestamp();
+			if (texture_timestamp == UINT64_MAX && buffer_timestamp == UINT64_MAX)
+				break;
+			if (texture_timestamp <= buffer_timestamp)
+				texturePool.evictForBudget();
+			else
+				bufferPool.evictForBudget();
+		}
+		std::lock_guard<std::mutex> lock(pipeline_mutex);
+		pipelinePool.newFrame();
+		computePipelinePool.newFrame();
+		renderPassPool.newFrame();
+	}
+
+	void SharedResourcePools::destroy()
+	{
+		texturePool.destroy();
+		bufferPool.destroy();
+		pipelinePool.destroy();
+		computePipelinePool.destroy();
+		renderPassPool.destroy();
+	}
+
+	ExecutorContext::ExecutorContext(CGPUDeviceId device, CGPUQueueId gfx_queue, bool profile, std::pmr::memory_resource* memory_resource, CGPUQueueId compute_queue, SharedResourcePools* shared_pools)
+		: device(device), memory_resource(memory_resource), renderPassPool(device, shared_pools ? &shared_pools->renderPassPool : nullptr, memory_resource), framebufferPool(device, memory_resource), texturePool(device, gfx_queue, shared_pools ? &shared_pools->texturePool : nullptr, memory_resource), pipelinePool(device, shared_pools ? &shared_pools->pipelinePool : nullptr, memory_resource), computePipelinePool(device, shared_pools ? &shared_pools->computePipelinePool : nullptr, memory_resource), textureViewPool(nullptr, memory_resource), bufferPool(device, shared_pools ? &shared_pools->bufferPool : nullptr, memory_resource)
+		, pool_mutex(std::make_unique<std::mutex>()), pipeline_mutex(shared_pools ? &shared_pools->pipeline_mutex : pool_mutex.get()), gfx_queue(gfx_queue), compute_queue(compute_queue), recorders(memory_resource), semaphores(memory_resource), submit_cmds(memory_resource), submit_batches(memory_resource)
+	{
+		requestRecorder(0);
 		if (profile)
 			profiler = new Profiler(device, gfx_queue, memory_resource);
 		auto adapter_detail = cgpu_adapter_query_adapter_detail(device->adapter);
@@ -688,46 +1053,66 @@ namespace HGEGraphics
 	{
 		++timestamp;
 
-		cgpu_command_pool_reset(cmdPool);
+		for (auto recorder : recorders)
+			recorder->newFrame();
 
-		for (auto cmd : allocated_cmds)
-			cmds.push_back(cmd);
-		allocated_cmds.clear();
-
-		global_texture_table.clear();
-		global_sampler_table.clear();
-		global_buffer_table.clear();
+		used_semaphore_count = 0;
+		submit_cmds.clear();
+		submit_batches.clear();
 
+		recycleTransientResources();
 		framebufferPool.newFrame();
-		descriptorSetPool.newFrame();
 		textureViewPool.newFrame();
 		bufferPool.newFrame();
 		pipelinePool.newFrame();
 		computePipelinePool.newFrame();
 		renderPassPool.newFrame();
 		texturePool.newFrame();
+	}
 
-		for (auto& dset : allocated_dsets)
-			descriptorSetPool.releaseResource(dset);
-		allocated_dsets.clear();
+	void ExecutorContext::recycleTransientResources()
+	{
+		texturePool.recycle();
+		bufferPool.recycle();
 	}
 
-	CGPUCommandBufferId ExecutorContext::requestCmd()
+	void ExecutorContext::forgetTexture(CGPUTextureId texture)
 	{
-		CGPUCommandBufferId cmd;
-		if (!cmds.empty())
-		{
-			cmd = cmds.back();
-			cmds.pop_back();
-		}
-		else
+		framebufferPool.evictIf([texture](const Framebuffer& framebuffer)
+			{
+				auto& descriptor = framebuffer._descriptor;
+				return std::any_of(descriptor.p_attachments, descriptor.p_attachments + descriptor.attachment_count, [texture](CGPUTextureViewId view) { return view->info.texture == texture; });
+			});
+		textureViewPool.evictIf([texture](const TextureView& view) { return view._descriptor.texture == texture; });
+	}
+
+	CommandRecorder* ExecutorContext::requestRecorder(size_t index)
+	{
+		while (recorders.size() <= index)
+			recorders.push_back(new CommandRecorder(gfx_queue, compute_queue, memory_resource));
+		return recorders[index];
+	}
+
+	DescriptorSetArenaStats ExecutorContext::descriptorSetStats() const
+	{
+		DescriptorSetArenaStats stats;
+		for (auto recorder : recorders)
 		{
-			CGPUCommandBufferDescriptor cmd_desc = { .is_secondary = false };
-			cmd = cgpu_command_pool_create_command_buffer(cmdPool, &cmd_desc);
+			auto recorder_stats = recorder->descriptorSets.stats();
+			stats.arena_count += recorder_stats.arena_count;
+			stats.acquired += recorder_stats.acquired;
+			stats.peak_acquired += recorder_stats.peak_acquired;
+			stats.resident += recorder_stats.resident;
+			stats.created += recorder_stats.created;
 		}
+		return stats;
+	}
 
-		allocated_cmds.push_back(cmd);
-		return cmd;
+	CGPUSemaphoreId ExecutorContext::requestSemaphore()
+	{
+		if (used_semaphore_count == semaphores.size())
+			semaphores.push_back(cgpu_device_create_semaphore(device));
+		return semaphores[used_semaphore_count++];
 	}
 
 	void ExecutorContext::destroy()
@@ -741,31 +1126,25 @@ namespace HGEGraphics
 		renderPassPool.destroy();
 		texturePool.destroy();
 		bufferPool.destroy();
-		for (auto cmd : cmds)
+		for (auto recorder : recorders)
 		{
-			cgpu_command_pool_free_command_buffer(cmdPool, cmd);
+			recorder->destroy();
+			delete recorder;
 		}
-		cmds.clear();
-		for (auto cmd : allocated_cmds)
+		recorders.clear();
+		for (auto semaphore : semaphores)
 		{
-			cgpu_command_pool_free_command_buffer(cmdPool, cmd);
+			cgpu_device_free_semaphore(device, semaphore);
 		}
-		allocated_cmds.clear();
-		if (cmdPool)
-			cgpu_queue_free_command_pool(cmdPool->queue, cmdPool);
-		cmdPool = CGPU_NULLPTR;
-		global_texture_table.clear();
-		global_sampler_table.clear();
-		global_buffer_table.clear();
+		semaphores.clear();
+		used_semaphore_count = 0;
+		submit_cmds.clear();
+		submit_batches.clear();
 		device = CGPU_NULLPTR;
 	}
 	void ExecutorContext::pre_destroy()
 	{
-		for (auto& dset : allocated_dsets)
-		{
-			descriptorSetPool.releaseResource(dset);
-		}
-		allocated_dsets.clear();
-		descriptorSetPool.destroy();
+		for (auto recorder : recorders)
+			recorder->descriptorSets.destroy();
 	}
 }
\ No newline at end of file
@@ -70,10 +70,12 @@ namespace HGEGraphics
 		self->passes.emplace_back(name, PASS_TYPE_RENDER, self->allocator.resource());
 		return renderpass_builder_t(self, &(self->passes.back()), self->passes.size() - 1);
 	}
-	renderpass_builder_t rendergraph_add_computepass(rendergraph_t* self, const char* name)
+	renderpass_builder_t rendergraph_add_computepass(rendergraph_t* self, const char* name, ECGPUQueueType queue)
 	{
 		assert(self->passes.size() <= MAX_INDEX);
+		assert(queue == CGPU_QUEUE_TYPE_GRAPHICS || queue == CGPU_QUEUE_TYPE_COMPUTE);
 		self->passes.emplace_back(name, PASS_TYPE_COMPUTE, self->allocator.resource());
+		self->passes.back().compute_context.queue = queue;
 		return renderpass_builder_t(self, &(self->passes.back()), self->passes.size() - 1);
 	}
 	renderpass_builder_t rendergraph_add_holdpass(rendergraph_t* self, const char* name)
@@ -259,8 +261,7 @@ namespace HGEGraphics
 		self->resources.push_back(ResourceNode());
 		auto& resourceNode = self->resources.back();
 		auto texture = &imported->texture;
-		texture->cur_states[0] = CGPU_RESOURCE_STATE_UNDEFINED;
-		texture->states_consistent = true;
+		texture->cur_states.set(0, texture->cur_states.size(), CGPU_RESOURCE_STATE_UNDEFINED);
 		return rendergraph_import_texture(self, texture);
 	}
 	buffer_handle_t rendergraph_declare_buffer(rendergraph_t* self)
@@ -373,7 +374,7 @@ namespace HGEGraphics
 		return self->edges.size() - 1;
 	}
 	ResourceNode::ResourceNode()
-		: name(nullptr), resourceType(ResourceType::Texture), manageType(ManageType::Managed), width(0), height(0), depth(0), format(ECGPUTextureFormat::CGPU_TEXTURE_FORMAT_UNDEFINED), texture(nullptr), buffer(nullptr), holdOnLast(false), bufferType(CGPU_RESOURCE_TYPE_NONE), memoryUsage(CGPU_MEMORY_USAGE_UNKNOWN), size(0), mipCount(0), arraySize(0), parent(0), mipLevel(0), arraySlice(0)
+		: name(nullptr), resourceType(ResourceType::Texture), manageType(ManageType::Managed), width(0), height(0), depth(0), format(ECGPUTextureFormat::CGPU_TEXTURE_FORMAT_UNDEFINED), texture(nullptr), buffer(nullptr), holdOnLast(false), bufferType(CGPU_RESOURCE_TYPE_NONE), textureType(CGPU_RESOURCE_TYPE_NONE), memoryUsage(CGPU_MEMORY_USAGE_UNKNOWN), size(0), mipCount(0), arraySize(0), parent(0), mipLevel(0), arraySlice(0)
 	{
 	}
 	renderpass_builder_t::renderpass_builder_t(rendergraph_t* renderGraph, RenderPassNode* passNode, int passIndex)
@@ -443,6 +444,8 @@ namespace HGEGraphics
 			state = CGPU_RESOURCE_STATE_INDEX_BUFFER;
 		else if (resourceNode.bufferType & CGPU_RESOURCE_TYPE_UNIFORM_BUFFER)
 			state = CGPU_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+		else if (resourceNode.bufferType & CGPU_RESOURCE_TYPE_BUFFER)
+			state = CGPU_RESOURCE_STATE_SHADER_RESOURCE;
 		assert(state != CGPU_RESOURCE_STATE_UNDEFINED);
 
 		auto edge = rendergraph_add_edge(self->renderGraph, get_buffer_handle_index(buffer), self->passIndex, state);
@@ -481,6 +484,8 @@ namespace HGEGraphics
 			state = CGPU_RESOURCE_STATE_INDEX_BUFFER;
 		else if (resourceNode.bufferType == CGPU_RESOURCE_TYPE_UNIFORM_BUFFER)
 			state = CGPU_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+		else if (resourceNode.bufferType == CGPU_RESOURCE_TYPE_BUFFER)
+			state = CGPU_RESOURCE_STATE_SHADER_RESOURCE;
 		else if (resourceNode.bufferType == CGPU_RESOURCE_TYPE_RW_BUFFER)
 			state = CGPU_RESOURCE_STATE_UNORDERED_ACCESS;
 		assert(state != CGPU_RESOURCE_STATE_UNDEFINED);
@@ -500,6 +505,19 @@ namespace HGEGraphics
 	}
 	void computepass_readwrite_texture(renderpass_builder_t* self, texture_handle_t texture)
 	{
+		assert(rendergraph_texture_handle_valid(texture));
+		auto& resourceNode = self->renderGraph->resources[get_texture_handle_index(texture)];
+		assert(resourceNode.resourceType == ResourceType::Texture);
+
+		// a subresource is written through its parent, which is the one created with rw texture usage
+		auto& textureNode = resourceNode.manageType == ManageType::SubResource ? self->renderGraph->resources[resourceNode.parent] : resourceNode;
+		if (textureNode.manageType == ManageType::Managed)
+			textureNode.textureType |= CGPU_RESOURCE_TYPE_RW_TEXTURE;
+
+		auto edge = rendergraph_add_edge(self->renderGraph, get_texture_handle_index(texture), self->passIndex, CGPU_RESOURCE_STATE_UNORDERED_ACCESS);
+		self->passNode->reads.push_back(edge);
+		auto edge2 = rendergraph_add_edge(self->renderGraph, self->passIndex, get_texture_handle_index(texture), CGPU_RESOURCE_STATE_UNORDERED_ACCESS);
+		self->passNode->writes.push_back(edge2);
 	}
 	void computepass_readwrite_buffer(renderpass_builder_t* self, buffer_handle_t buffer)
 	{
@@ -533,6 +551,28 @@ namespace HGEGraphics
 		assert(resourceNode.resourceType == ResourceType::Texture);
 		resourceNode.format = format;
 	}
+	void rg_texture_set_mip_count(rendergraph_t* self, texture_handle_t texture, uint32_t mipCount)
+	{
+		assert(is_valid_dynamic_texture_handle(self->resources, texture));
+		auto& resourceNode = self->resources[get_texture_handle_index(texture)];
+		assert(resourceNode.resourceType == ResourceType::Texture && resourceNode.manageType == ManageType::Managed);
+		assert(mipCount > 0 && mipCount <= UINT8_MAX);
+		resourceNode.mipCount = mipCount;
+	}
+	void rg_texture_set_array_size(rendergraph_t* self, texture_handle_t texture, uint32_t arraySize)
+	{
+		assert(is_valid_dynamic_texture_handle(self->resources, texture));
+		auto& resourceNode = self->resources[get_texture_handle_index(texture)];
+		assert(resourceNode.resourceType == ResourceType::Texture && resourceNode.manageType == ManageType::Managed);
+		assert(arraySize > 0 && arraySize <= UINT8_MAX);
+		resourceNode.arraySize = arraySize;
+	}
+	void rg_texture_set_cube(rendergraph_t* self, texture_handle_t texture, uint32_t cubeCount)
+	{
+		rg_texture_set_array_size(self, texture, cubeCount * 6);
+		auto& resourceNode = self->resources[get_texture_handle_index(texture)];
+		resourceNode.textureType |= CGPU_RESOURCE_TYPE_TEXTURE_CUBE;
+	}
 	void rg_texture_set_depth_format(rendergraph_t* self, texture_handle_t texture, DepthBits depthBits, bool needStencil)
 	{
 		assert(is_valid_dynamic_texture_handle(self->resources, texture));
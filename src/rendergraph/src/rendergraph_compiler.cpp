@@ -3,85 +3,790 @@
 #include "dependencygraph.h"
 #include <cassert>
 #include <algorithm>
+#include <bit>
 #include "renderer.h"
+#include "hash.h"
 
 namespace HGEGraphics
 {
-	CompiledRenderGraph Compiler::Compile(const rendergraph_t& renderGraph, std::pmr::memory_resource* const memory_resource)
+	void copy_pass_frame_data(CompiledRenderPassNode& compiledPass, const RenderPassNode& pass)
 	{
-		auto resourceCount = renderGraph.resources.size();
-		auto passCount = renderGraph.passes.size();
-		auto edgeCount = renderGraph.edges.size();
-		
-		struct Node
+		compiledPass.name = pass.name;
+		if (pass.type == PASS_TYPE_RENDER)
+		{
+			for (auto j = 0; j < pass.render_context.colorAttachmentCount; ++j)
+			{
+				compiledPass.colorAttachments[j].clearColor = pass.render_context.colorAttachments[j].clearColor;
+			}
+			compiledPass.depthAttachment.clearDepth = pass.render_context.depthAttachment.clearDepth;
+			compiledPass.depthAttachment.clearStencil = pass.render_context.depthAttachment.clearStencil;
+			compiledPass.executable = pass.render_context.executable;
+		}
+		else if (pass.type == PASS_TYPE_COMPUTE)
+		{
+			compiledPass.executable = pass.compute_context.executable;
+		}
+		else if (pass.type == PASS_TYPE_UPLOAD_TEXTURE)
+		{
+			compiledPass.uploadTextureExecutable = pass.upload_texture_context.executable;
+			compiledPass.size = pass.upload_texture_context.size;
+			compiledPass.offset = pass.upload_texture_context.offset;
+			compiledPass.data = pass.upload_texture_context.data;
+		}
+		else if (pass.type == PASS_TYPE_UPLOAD_BUFFER)
+		{
+			compiledPass.uploadTextureExecutable = pass.upload_buffer_context.executable;
+			compiledPass.size = pass.upload_buffer_context.size;
+			compiledPass.offset = pass.upload_buffer_context.offset;
+			compiledPass.data = pass.upload_buffer_context.data;
+		}
+		compiledPass.passdata = pass.passdata;
+	}
+
+	void copy_resource_frame_data(CompiledResourceNode& compiledResource, const ResourceNode& resource)
+	{
+		compiledResource.name = resource.name;
+		compiledResource.imported_texture = resource.texture;
+		compiledResource.imported_buffer = resource.buffer;
+		compiledResource.managered_texture = nullptr;
+		compiledResource.managed_buffer = nullptr;
+	}
+
+	uint64_t transient_resource_size(const CompiledResourceNode& resource)
+	{
+		if (resource.resourceType == ResourceType::Buffer)
+			return resource.size;
+
+		auto mipedSize = [](uint64_t size, uint64_t mip) { return std::max<uint64_t>(size >> mip, 1ull); };
+		uint64_t size = 0;
+		uint32_t mipCount = std::max<uint32_t>(resource.mipCount, 1);
+		for (uint32_t mip = 0; mip < mipCount; ++mip)
 		{
-			Node(index_type_t index, bool is_pass, bool is_persistent, std::pmr::memory_resource* const resource)
-				: index(index), is_pass(is_pass), is_persistent(is_persistent), ins(resource), outs(resource)
+			const uint64_t xBlocksCount = (mipedSize(resource.width, mip) + FormatUtil_WidthOfBlock(resource.format) - 1) / FormatUtil_WidthOfBlock(resource.format);
+			const uint64_t yBlocksCount = (mipedSize(resource.height, mip) + FormatUtil_HeightOfBlock(resource.format) - 1) / FormatUtil_HeightOfBlock(resource.format);
+			const uint64_t zBlocksCount = mipedSize(resource.depth, mip);
+			size += xBlocksCount * yBlocksCount * zBlocksCount * FormatUtil_BitSizeOfBlock(resource.format) / 8;
+		}
+		return size * std::max<uint32_t>(resource.arraySize, 1);
+	}
+
+	// the texture a subresource node is part of, or the resource itself
+	template<typename ResourceNodeType>
+	index_type_t root_of(const std::pmr::vector<ResourceNodeType>& resources, index_type_t resource)
+	{
+		auto parent = resources[resource].parent;
+		return parent != 0 ? parent : resource;
+	}
+
+	bool same_texture_descriptor(const CompiledResourceNode& a, const CompiledResourceNode& b)
+	{
+		return a.width == b.width && a.height == b.height && a.depth == b.depth && a.format == b.format && a.mipCount == b.mipCount && a.arraySize == b.arraySize && a.textureType == b.textureType;
+	}
+
+	// the pools hand a released resource back out to the next request with an identical descriptor, even within one frame
+	bool pool_reusable(const CompiledResourceNode& a, const CompiledResourceNode& b)
+	{
+		if (a.resourceType != b.resourceType)
+			return false;
+		if (a.resourceType == ResourceType::Texture)
+			return same_texture_descriptor(a, b);
+		return a.bufferType == b.bufferType && a.memoryUsage == b.memoryUsage && a.size == b.size;
+	}
+
+	bool transient_slot_compatible(const CompiledResourceNode& a, const CompiledResourceNode& b)
+	{
+		if (a.resourceType != b.resourceType)
+			return false;
+		if (a.resourceType == ResourceType::Texture)
+			return same_texture_descriptor(a, b);
+		// cpu visible buffers are written while recording, before any pass has run, so they can't share memory
+		return a.bufferType == b.bufferType && a.memoryUsage == CGPU_MEMORY_USAGE_GPU_ONLY && b.memoryUsage == CGPU_MEMORY_USAGE_GPU_ONLY;
+	}
+
+	// greedy interval assignment: a resource takes over a slot whose previous occupant has been destroyed before its first pass
+	void plan_transient_aliasing(CompiledRenderGraph& compiled, std::pmr::vector<TransientLifetime>& lifetimes, size_t passCount)
+	{
+		std::stable_sort(lifetimes.begin(), lifetimes.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+		auto& report = compiled.transient_memory;
+		report = {};
+		compiled.transient_slots.clear();
+		compiled.transient_slots.reserve(lifetimes.size());
+		std::pmr::vector<int64_t> live_delta(passCount + 1, 0, compiled.transient_slots.get_allocator().resource());
+		std::pmr::vector<bool> slot_single_queue(compiled.transient_slots.get_allocator().resource());
+		// resource and last pass of what the pools alone would keep allocated, without any slots
+		std::pmr::vector<std::pair<index_type_t, index_type_t>> pooled(compiled.transient_slots.get_allocator().resource());
+		for (auto& lifetime : lifetimes)
+		{
+			auto& resource = compiled.resources[lifetime.resource];
+			auto size = transient_resource_size(resource);
+			report.resource_count++;
+			live_delta[lifetime.first] += size;
+
+			auto reused = std::find_if(pooled.begin(), pooled.end(), [&](auto& entry) { return entry.second < lifetime.first && pool_reusable(compiled.resources[entry.first], resource); });
+			if (reused == pooled.end())
 			{
+				pooled.push_back({ lifetime.resource, lifetime.last });
+				report.requested_bytes += size;
 			}
+			else
+				reused->second = lifetime.last;
+			live_delta[lifetime.last + 1] -= size;
+
+			index_type_t best = MAX_INDEX;
+			for (index_type_t j = 0; j < compiled.transient_slots.size(); ++j)
+			{
+				auto& slot = compiled.transient_slots[j];
+				if (slot.last_pass >= lifetime.first || !transient_slot_compatible(compiled.resources[slot.first_resource], resource))
+					continue;
+				// batches on different queues may overlap, whatever their order in the graph
+				if (!lifetime.single_queue || !slot_single_queue[j] || slot.queue != lifetime.queue)
+					continue;
+				if (best == MAX_INDEX)
+				{
+					best = j;
+					continue;
+				}
+				// prefer the smallest slot that already fits, otherwise the largest one to grow
+				auto& best_slot = compiled.transient_slots[best];
+				bool fits = slot.size >= size, best_fits = best_slot.size >= size;
+				if ((fits && (!best_fits || slot.size < best_slot.size)) || (!fits && !best_fits && slot.size > best_slot.size))
+					best = j;
+			}
+
+			if (best == MAX_INDEX)
+			{
+				best = compiled.transient_slots.size();
+				compiled.transient_slots.push_back({ .resourceType = resource.resourceType, .first_resource = lifetime.resource, .last_resource = lifetime.resource, .last_pass = lifetime.last, .queue = lifetime.queue, .size = size });
+				slot_single_queue.push_back(lifetime.single_queue);
+			}
+			else
+			{
+				auto& slot = compiled.transient_slots[best];
+				slot.last_resource = lifetime.resource;
+				slot.last_pass = lifetime.last;
+				slot.size = std::max(slot.size, size);
+			}
+			resource.alias_slot = best;
+		}
+
+		int64_t live = 0;
+		for (size_t i = 0; i < passCount; ++i)
+		{
+			live += live_delta[i];
+			report.peak_bytes = std::max<uint64_t>(report.peak_bytes, live);
+		}
+		report.slot_count = compiled.transient_slots.size();
+		for (auto& slot : compiled.transient_slots)
+			report.aliased_bytes += slot.size;
+	}
+
+	// list scheduling of the passes that survived culling, dependencies come from the declared order of accesses to each resource.
+	// among the ready passes the one needing the fewest state transitions goes first, then the one that has been ready the longest,
+	// so consumers drift away from their producers. ties are broken by declaration order, the result only depends on the graph.
+	void schedule_passes(const rendergraph_t& renderGraph, std::pmr::vector<index_type_t>& order, std::pmr::memory_resource* const memory_resource)
+	{
+		auto passCount = renderGraph.passes.size();
+		auto resourceCount = renderGraph.resources.size();
 
-			bool is_culled() const
+		struct Reader
+		{
+			index_type_t pass;
+			index_type_t next;
+		};
+		std::pmr::vector<std::pair<index_type_t, index_type_t>> dependencies(memory_resource);
+		std::pmr::vector<index_type_t> last_writer(resourceCount, MAX_INDEX, memory_resource);
+		std::pmr::vector<index_type_t> first_reader(resourceCount, MAX_INDEX, memory_resource);
+		std::pmr::vector<Reader> readers(memory_resource);
+		for (auto passIndex : order)
+		{
+			auto& pass = renderGraph.passes[passIndex];
+			for (auto edgeIndex : pass.reads)
 			{
-				return ref_count == 0 && !is_persistent;
+				auto resource = root_of(renderGraph.resources, renderGraph.edges[edgeIndex].from);
+				if (last_writer[resource] != MAX_INDEX && last_writer[resource] != passIndex)
+					dependencies.push_back({ last_writer[resource], passIndex });
+				readers.push_back({ passIndex, first_reader[resource] });
+				first_reader[resource] = readers.size() - 1;
 			}
+			for (auto edgeIndex : pass.writes)
+			{
+				auto resource = root_of(renderGraph.resources, renderGraph.edges[edgeIndex].to);
+				if (last_writer[resource] != MAX_INDEX && last_writer[resource] != passIndex)
+					dependencies.push_back({ last_writer[resource], passIndex });
+				for (auto reader = first_reader[resource]; reader != MAX_INDEX; reader = readers[reader].next)
+				{
+					if (readers[reader].pass != passIndex)
+						dependencies.push_back({ readers[reader].pass, passIndex });
+				}
+				first_reader[resource] = MAX_INDEX;
+				last_writer[resource] = passIndex;
+			}
+		}
+		std::sort(dependencies.begin(), dependencies.end());
+		dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
 
-			std::pmr::vector<index_type_t> ins;
-			std::pmr::vector<index_type_t> outs;
-			index_type_t index = 0;
-			uint32_t ref_count = 0;
-			bool is_pass;
-			bool is_persistent{ false };
+		std::pmr::vector<uint32_t> successor_offsets(passCount + 1, 0, memory_resource);
+		std::pmr::vector<uint32_t> indegree(passCount, 0, memory_resource);
+		for (auto& [from, to] : dependencies)
+		{
+			successor_offsets[from + 1]++;
+			indegree[to]++;
+		}
+		for (size_t i = 0; i < passCount; ++i)
+			successor_offsets[i + 1] += successor_offsets[i];
+
+		struct ReadyPass
+		{
+			index_type_t pass;
+			uint32_t ready_time;
 		};
+		std::pmr::vector<ReadyPass> ready(memory_resource);
+		for (auto passIndex : order)
+		{
+			if (indegree[passIndex] == 0)
+				ready.push_back({ passIndex, 0 });
+		}
+
+		std::pmr::vector<ECGPUResourceStateFlags> states(resourceCount, CGPU_RESOURCE_STATE_UNDEFINED, memory_resource);
+		auto transition_count = [&](const RenderPassNode& pass)
+			{
+				uint32_t count = 0;
+				auto count_edge = [&](index_type_t resource, ECGPUResourceStateFlags usage)
+					{
+						auto state = states[root_of(renderGraph.resources, resource)];
+						if (usage != CGPU_RESOURCE_STATE_UNDEFINED && state != CGPU_RESOURCE_STATE_UNDEFINED && state != usage)
+							++count;
+					};
+				for (auto edgeIndex : pass.reads)
+					count_edge(renderGraph.edges[edgeIndex].from, renderGraph.edges[edgeIndex].usage);
+				for (auto edgeIndex : pass.writes)
+					count_edge(renderGraph.edges[edgeIndex].to, renderGraph.edges[edgeIndex].usage);
+				return count;
+			};
+
+		auto scheduledCount = order.size();
+		order.clear();
+		uint32_t time = 0;
+		while (!ready.empty())
+		{
+			size_t best = 0;
+			uint32_t best_cost = transition_count(renderGraph.passes[ready[0].pass]);
+			for (size_t i = 1; i < ready.size(); ++i)
+			{
+				auto cost = transition_count(renderGraph.passes[ready[i].pass]);
+				auto& a = ready[i];
+				auto& b = ready[best];
+				if (cost < best_cost || (cost == best_cost && (a.ready_time < b.ready_time || (a.ready_time == b.ready_time && a.pass < b.pass))))
+				{
+					best = i;
+					best_cost = cost;
+				}
+			}
+
+			auto passIndex = ready[best].pass;
+			ready.erase(ready.begin() + best);
+			order.push_back(passIndex);
+			++time;
+
+			auto& pass = renderGraph.passes[passIndex];
+			for (auto edgeIndex : pass.reads)
+			{
+				auto& edge = renderGraph.edges[edgeIndex];
+				if (edge.usage != CGPU_RESOURCE_STATE_UNDEFINED)
+					states[root_of(renderGraph.resources, edge.from)] = edge.usage;
+			}
+			for (auto edgeIndex : pass.writes)
+			{
+				auto& edge = renderGraph.edges[edgeIndex];
+				if (edge.usage != CGPU_RESOURCE_STATE_UNDEFINED)
+					states[root_of(renderGraph.resources, edge.to)] = edge.usage;
+			}
+
+			for (auto i = successor_offsets[passIndex]; i < successor_offsets[passIndex + 1]; ++i)
+			{
+				auto successor = dependencies[i].second;
+				if (--indegree[successor] == 0)
+					ready.push_back({ successor, time });
+			}
+		}
+		assert(order.size() == scheduledCount);
+	}
+
+	// split the passes into one batch per queue switch, then work out the semaphores and ownership transfers between batches.
+	// the first and the last batch are always graphics ones, they wait for the swapchain and signal the frame fence
+	void build_batches(CompiledRenderGraph& compiled)
+	{
+		auto memory_resource = compiled.batches.get_allocator().resource();
+		auto& batches = compiled.batches;
+		batches.clear();
+		batches.emplace_back(CGPU_QUEUE_TYPE_GRAPHICS, 0, memory_resource);
+		for (index_type_t i = 0; i < compiled.passes.size(); ++i)
+		{
+			if (compiled.passes[i].queue != batches.back().queue)
+			{
+				batches.back().end_pass = i;
+				batches.emplace_back(compiled.passes[i].queue, i, memory_resource);
+			}
+		}
+		batches.back().end_pass = compiled.passes.size();
+		if (batches.back().queue != CGPU_QUEUE_TYPE_GRAPHICS)
+			batches.emplace_back(CGPU_QUEUE_TYPE_GRAPHICS, compiled.passes.size(), memory_resource).end_pass = compiled.passes.size();
+		if (batches.size() == 1)
+			return;
+
+		auto cross_queue = [&](index_type_t resource, index_type_t from, index_type_t to)
+			{
+				auto& batch = batches[to];
+				batch.wait_batch = batch.wait_batch == MAX_INDEX ? from : std::max(batch.wait_batch, from);
+				batches[from].releases.push_back({ resource, batch.queue });
+				batch.acquires.push_back({ resource, batches[from].queue });
+			};
+
+		// imported resources are owned by the graphics queue between frames
+		std::pmr::vector<index_type_t> last_batch(compiled.resources.size(), MAX_INDEX, memory_resource);
+		for (index_type_t i = 0; i < compiled.resources.size(); ++i)
+		{
+			if (compiled.resources[i].manageType == ManageType::Imported)
+				last_batch[i] = 0;
+		}
+
+		for (index_type_t b = 0; b < batches.size(); ++b)
+		{
+			for (auto i = batches[b].first_pass; i < batches[b].end_pass; ++i)
+			{
+				auto touch = [&](index_type_t resourceIndex)
+					{
+						auto resource = root_of(compiled.resources, resourceIndex);
+						auto from = last_batch[resource];
+						if (from != MAX_INDEX && batches[from].queue != batches[b].queue)
+							cross_queue(resource, from, b);
+						last_batch[resource] = b;
+					};
+				for (auto& edge : compiled.reads(compiled.passes[i]))
+					touch(edge.index);
+				for (auto& edge : compiled.writes(compiled.passes[i]))
+					touch(edge.index);
+			}
+		}
+
+		index_type_t final_batch = batches.size() - 1;
+		index_type_t last_compute_batch = MAX_INDEX;
+		for (index_type_t b = 0; b < batches.size(); ++b)
+		{
+			if (batches[b].queue == CGPU_QUEUE_TYPE_COMPUTE)
+				last_compute_batch = b;
+		}
+		for (index_type_t i = 0; i < compiled.resources.size(); ++i)
+		{
+			if (compiled.resources[i].manageType == ManageType::Imported && batches[last_batch[i]].queue != CGPU_QUEUE_TYPE_GRAPHICS)
+				cross_queue(i, last_batch[i], final_batch);
+		}
+		// the frame fence only covers the graphics queue, so the last batch also waits for outstanding compute work
+		if (last_compute_batch != MAX_INDEX)
+			batches[final_batch].wait_batch = batches[final_batch].wait_batch == MAX_INDEX ? last_compute_batch : std::max(batches[final_batch].wait_batch, last_compute_batch);
+
+		// a semaphore wait covers everything the other queue submitted before the signal
+		index_type_t covered[2] = { MAX_INDEX, MAX_INDEX };
+		for (auto& batch : batches)
+		{
+			if (batch.wait_batch == MAX_INDEX)
+				continue;
+			auto& queue_covered = covered[batch.queue == CGPU_QUEUE_TYPE_COMPUTE ? 1 : 0];
+			if (queue_covered != MAX_INDEX && queue_covered >= batch.wait_batch)
+			{
+				batch.wait_batch = MAX_INDEX;
+				continue;
+			}
+			queue_covered = batch.wait_batch;
+			batches[batch.wait_batch].signal = true;
+		}
+	}
+
+	// a managed attachment has no content before its first pass and nobody looks at it after its last one
+	void infer_attachment_actions(CompiledRenderGraph& compiled)
+	{
+		auto& report = compiled.attachment_traffic;
+		report = {};
+
+		auto allocator = compiled.passes.get_allocator();
+		std::pmr::vector<index_type_t> first_use(compiled.resources.size(), MAX_INDEX, allocator.resource());
+		std::pmr::vector<index_type_t> last_use(compiled.resources.size(), MAX_INDEX, allocator.resource());
+		for (index_type_t i = 0; i < compiled.passes.size(); ++i)
+		{
+			auto touch = [&](index_type_t resource)
+				{
+					auto root = root_of(compiled.resources, resource);
+					if (first_use[root] == MAX_INDEX)
+						first_use[root] = i;
+					last_use[root] = i;
+				};
+			for (auto& edge : compiled.reads(compiled.passes[i]))
+				touch(edge.index);
+			for (auto& edge : compiled.writes(compiled.passes[i]))
+				touch(edge.index);
+		}
+
+		for (index_type_t i = 0; i < compiled.passes.size(); ++i)
+		{
+			auto& pass = compiled.passes[i];
+			if (pass.type != PASS_TYPE_RENDER)
+				continue;
+
+			auto infer = [&](index_type_t resourceIndex, ECGPULoadAction& load_action, ECGPUStoreAction& store_action, bool stencil)
+				{
+					auto& resource = compiled.resources[resourceIndex];
+					if (resource.manageType != ManageType::Managed)
+						return;
+					// stencil shares its texels with depth, they are only counted once
+					auto size = stencil ? 0 : transient_resource_size(resource);
+					if (load_action == CGPU_LOAD_ACTION_LOAD && first_use[resourceIndex] == i)
+					{
+						load_action = CGPU_LOAD_ACTION_DONT_CARE;
+						report.loads_skipped++;
+						report.load_bytes_saved += size;
+					}
+					if (store_action == CGPU_STORE_ACTION_STORE && last_use[resourceIndex] == i)
+					{
+						store_action = CGPU_STORE_ACTION_DISCARD;
+						report.stores_skipped++;
+						report.store_bytes_saved += size;
+					}
+				};
+			for (auto j = 0; j < pass.colorAttachmentCount; ++j)
+			{
+				auto& attachment = pass.colorAttachments[j];
+				infer(attachment.resourceIndex, attachment.load_action, attachment.store_action, false);
+			}
+			if (pass.depthAttachment.valid)
+			{
+				auto& attachment = pass.depthAttachment;
+				infer(attachment.resourceIndex, attachment.depth_load_action, attachment.depth_store_action, false);
+				infer(attachment.resourceIndex, attachment.stencil_load_action, attachment.stencil_store_action, true);
+			}
+		}
+	}
 
-		std::pmr::vector<Node> nodes(memory_resource);
-		nodes.reserve(passCount + resourceCount);
+	bool render_pass_attachment(const CompiledRenderPassNode& pass, index_type_t resource)
+	{
+		for (auto i = 0; i < pass.colorAttachmentCount; ++i)
+		{
+			if (pass.colorAttachments[i].resourceIndex == resource)
+				return true;
+		}
+		return pass.depthAttachment.valid && pass.depthAttachment.resourceIndex == resource;
+	}
+
+	// whether the pass renders to the texture or to any subresource of it
+	bool render_pass_attaches_root(const CompiledRenderGraph& compiled, const CompiledRenderPassNode& pass, index_type_t root)
+	{
+		for (auto i = 0; i < pass.colorAttachmentCount; ++i)
+		{
+			if (root_of(compiled.resources, pass.colorAttachments[i].resourceIndex) == root)
+				return true;
+		}
+		return pass.depthAttachment.valid && root_of(compiled.resources, pass.depthAttachment.resourceIndex) == root;
+	}
+
+	bool render_pass_mergeable(const CompiledRenderGraph& compiled, index_type_t first, index_type_t next)
+	{
+		auto& head = compiled.passes[first];
+		auto& pass = compiled.passes[next];
+		if (head.type != PASS_TYPE_RENDER || pass.type != PASS_TYPE_RENDER)
+			return false;
+		if (head.colorAttachmentCount + (head.depthAttachment.valid ? 1 : 0) == 0)
+			return false;
+
+		// same framebuffer, and nothing to clear halfway through
+		if (head.colorAttachmentCount != pass.colorAttachmentCount || head.depthAttachment.valid != pass.depthAttachment.valid)
+			return false;
+		for (auto i = 0; i < pass.colorAttachmentCount; ++i)
+		{
+			if (head.colorAttachments[i].resourceIndex != pass.colorAttachments[i].resourceIndex || pass.colorAttachments[i].load_action == CGPU_LOAD_ACTION_CLEAR)
+				return false;
+		}
+		if (pass.depthAttachment.valid)
+		{
+			if (head.depthAttachment.resourceIndex != pass.depthAttachment.resourceIndex || pass.depthAttachment.depth_load_action == CGPU_LOAD_ACTION_CLEAR || pass.depthAttachment.stencil_load_action == CGPU_LOAD_ACTION_CLEAR)
+				return false;
+		}
+
+		// the barriers of the whole chain are placed before the render pass begins, so a merged pass may not
+		// bring in new resources nor use one the chain already uses in another state
+		if (pass.devirtualize_count > 0)
+			return false;
+		auto conflicts = [&](const CompiledEdge& edge) -> bool
+			{
+				if (edge.usage == CGPU_RESOURCE_STATE_UNDEFINED || render_pass_attachment(pass, edge.index))
+					return false;
+				if (edge.usage == CGPU_RESOURCE_STATE_UNORDERED_ACCESS)
+					return true;
+				// the chain renders to its attachments from the start, no merged pass may sample any part of them
+				auto resource = root_of(compiled.resources, edge.index);
+				if (render_pass_attaches_root(compiled, head, resource))
+					return true;
+				for (auto j = first; j < next; ++j)
+				{
+					auto& other = compiled.passes[j];
+					for (auto& otherEdge : compiled.reads(other))
+					{
+						if (otherEdge.usage != CGPU_RESOURCE_STATE_UNDEFINED && otherEdge.usage != edge.usage && root_of(compiled.resources, otherEdge.index) == resource)
+							return true;
+					}
+				}
+				return false;
+			};
+		for (auto& edge : compiled.reads(pass))
+		{
+			if (conflicts(edge))
+				return false;
+		}
+		for (auto& edge : compiled.writes(pass))
+		{
+			if (conflicts(edge))
+				return false;
+		}
+		return true;
+	}
+
+	// cgpu render passes have a single subpass, so a chain runs as one render pass instance: the first pass loads, the last one stores
+	void merge_render_passes(CompiledRenderGraph& compiled)
+	{
+		compiled.merged_pass_count = 0;
+		index_type_t first = 0;
+		for (index_type_t i = 1; i < compiled.passes.size(); ++i)
+		{
+			if (!render_pass_mergeable(compiled, first, i))
+			{
+				first = i;
+				continue;
+			}
+
+			auto& head = compiled.passes[first];
+			auto& pass = compiled.passes[i];
+			for (auto j = 0; j < pass.colorAttachmentCount; ++j)
+				head.colorAttachments[j].store_action = pass.colorAttachments[j].store_action;
+			if (pass.depthAttachment.valid)
+			{
+				head.depthAttachment.depth_store_action = pass.depthAttachment.depth_store_action;
+				head.depthAttachment.stencil_store_action = pass.depthAttachment.stencil_store_action;
+			}
+			compiled.passes[i - 1].merge_with_next = true;
+			pass.merge_with_previous = true;
+			compiled.merged_pass_count++;
+		}
+	}
+
+	// states in which a pass can write, the same state on both sides of a hazard still needs a barrier
+	bool write_state(ECGPUResourceStateFlags state)
+	{
+		return state == CGPU_RESOURCE_STATE_RENDER_TARGET || state == CGPU_RESOURCE_STATE_DEPTH_WRITE || state == CGPU_RESOURCE_STATE_COPY_DEST || state == CGPU_RESOURCE_STATE_UNORDERED_ACCESS;
+	}
+
+	struct PlannedState
+	{
+		ECGPUResourceStateFlags state;
+		index_type_t last_pass;
+		bool known;
+		bool written;
+
+		bool operator==(const PlannedState& other) const = default;
+	};
+
+	// simulate every subresource through the frame once per topology, only the state a resource enters the frame with is left to the executor.
+	// subresources sharing a state are tracked and transitioned as one range
+	void plan_barriers(CompiledRenderGraph& compiled)
+	{
+		auto memory_resource = compiled.barriers.get_allocator().resource();
+		auto& barriers = compiled.barriers;
+		auto& report = compiled.barrier_report;
+		barriers.clear();
+		report = {};
+
+		// a resource taking over an aliased slot has to wait for the previous occupant
+		auto takes_over_slot = [&](index_type_t resource)
+			{
+				auto& node = compiled.resources[resource];
+				return node.manageType == ManageType::Managed && node.alias_slot != MAX_INDEX && compiled.transient_slots[node.alias_slot].first_resource != resource;
+			};
+
+		std::pmr::vector<SubresourceStates<PlannedState>> states(memory_resource);
+		states.reserve(compiled.resources.size());
+		for (auto& resource : compiled.resources)
+		{
+			auto& resource_states = states.emplace_back(memory_resource);
+			if (resource.resourceType == ResourceType::Buffer)
+				resource_states.reset(1, 1, { CGPU_RESOURCE_STATE_UNDEFINED, MAX_INDEX, false, false });
+			else
+				resource_states.reset(resource.mipCount, resource.arraySize, { CGPU_RESOURCE_STATE_UNDEFINED, MAX_INDEX, false, false });
+		}
+
+		using Piece = SubresourceStates<PlannedState>::Run;
+		std::pmr::vector<Piece> pieces(memory_resource);
+		index_type_t head = 0;
+		for (index_type_t p = 0; p < compiled.passes.size(); ++p)
+		{
+			auto& pass = compiled.passes[p];
+			if (!pass.merge_with_previous)
+				head = p;
+			const uint32_t begin = barriers.size();
+			pass.first_barrier = begin;
+			pass.barrier_count = 0;
+
+			auto plan_edges = [&](std::span<const CompiledEdge> edges, bool write)
+				{
+					for (auto& edge : edges)
+					{
+						if (edge.usage == CGPU_RESOURCE_STATE_UNDEFINED)
+							continue;
+
+						auto& node = compiled.resources[edge.index];
+						auto root = root_of(compiled.resources, edge.index);
+						auto& root_states = states[root];
+						const bool whole = node.manageType != ManageType::SubResource;
+						const uint32_t first = whole ? 0 : node.mipLevel + node.arraySlice * root_states.mip_count();
+						const uint32_t count = whole ? root_states.size() : 1;
+						const auto dst = edge.usage;
+						const bool hazard = write_state(dst);
+						const bool first_use_force = hazard || takes_over_slot(root);
+
+						// neighbouring pieces that only differ in their last pass go out as one barrier
+						const size_t edge_begin = barriers.size();
+						auto emit = [&](uint32_t range_first, uint32_t range_count, ECGPUResourceStateFlags src, index_type_t begin_pass, bool resolve_src)
+							{
+								if (barriers.size() > edge_begin)
+								{
+									auto& last = barriers.back();
+									if (last.resolve_src == resolve_src && last.src_state == src && last.first_subresource + last.subresource_count == range_first)
+									{
+										last.subresource_count += range_count;
+										if (!resolve_src)
+											last.begin_pass = std::max(last.begin_pass, begin_pass);
+										return;
+									}
+								}
+								barriers.push_back({
+									.resource = root,
+									.src_state = src,
+									.dst_state = dst,
+									.begin_pass = begin_pass,
+									.first_subresource = range_first,
+									.subresource_count = range_count,
+									.resolve_src = resolve_src,
+									.force = resolve_src && first_use_force,
+									});
+							};
+
+						pieces.clear();
+						root_states.visit(first, count, [&](uint32_t piece_first, uint32_t piece_count, const PlannedState& state) { pieces.push_back({ piece_first, piece_count, state }); });
+
+						// a merged pass draws to the attachments its render pass instance already transitioned
+						const bool covered = pass.merge_with_previous && (dst == CGPU_RESOURCE_STATE_RENDER_TARGET || dst == CGPU_RESOURCE_STATE_DEPTH_WRITE);
+						for (auto& piece : pieces)
+						{
+							auto state = piece.value;
+							bool placed = false;
+							if (!covered && !state.known)
+							{
+								emit(piece.first, piece.count, dst, MAX_INDEX, true);
+								placed = true;
+							}
+							else if (!covered && (state.state != dst || (state.written && hazard)))
+							{
+								emit(piece.first, piece.count, state.state, state.last_pass, false);
+								placed = true;
+							}
+							root_states.set(piece.first, piece.count, { dst, p, true, write || (state.written && !placed) });
+						}
+					}
+				};
+			plan_edges(compiled.reads(pass), false);
+			plan_edges(compiled.writes(pass), true);
+
+			compiled.passes[head].barrier_count += barriers.size() - begin;
+			for (auto b = begin; b < barriers.size(); ++b)
+			{
+				if (barriers[b].begin_pass != MAX_INDEX && barriers[b].begin_pass + 1 < head)
+					++report.split_candidates;
+			}
+		}
+		report.planned_barriers = barriers.size();
+	}
+
+	CompiledRenderGraph Compiler::Compile(const rendergraph_t& renderGraph, std::pmr::memory_resource* const memory_resource, PassSchedule schedule, bool async_compute, CompilerWorkspace* workspace)
+	{
+		auto resourceCount = renderGraph.resources.size();
+		auto passCount = renderGraph.passes.size();
+		auto nodeCount = passCount + resourceCount;
+
+		CompilerWorkspace local_workspace(memory_resource);
+		auto& ws = workspace ? *workspace : local_workspace;
+
+		// a pass reads its ins and writes its outs, a resource is written by its ins and read by its outs
+		auto& in_offsets = ws.in_offsets;
+		auto& out_offsets = ws.out_offsets;
+		in_offsets.assign(nodeCount + 1, 0);
+		out_offsets.assign(nodeCount + 1, 0);
 		for (index_type_t i = 0; i < passCount; ++i)
 		{
 			auto const& pass = renderGraph.passes[i];
-			Node node(i, true, pass.type == PASS_TYPE_PRESENT || pass.type == PASS_TYPE_HOLDON, memory_resource);
-			node.ins.reserve(pass.reads.size());
-			for (index_type_t j = 0; j < pass.reads.size(); ++j)
-				node.ins.push_back(renderGraph.edges[pass.reads[j]].from + passCount);
-			node.outs.reserve(pass.writes.size());
-			for (index_type_t j = 0; j < pass.writes.size(); ++j)
-				node.outs.push_back(renderGraph.edges[pass.writes[j]].to + passCount);
-			nodes.emplace_back(std::move(node));
+			in_offsets[i + 1] += pass.reads.size();
+			out_offsets[i + 1] += pass.writes.size();
+			for (auto edgeIndex : pass.reads)
+				out_offsets[renderGraph.edges[edgeIndex].from + passCount + 1]++;
+			for (auto edgeIndex : pass.writes)
+				in_offsets[renderGraph.edges[edgeIndex].to + passCount + 1]++;
 		}
-
-		for (index_type_t i = 0; i < resourceCount; ++i)
+		for (size_t i = 0; i < nodeCount; ++i)
 		{
-			auto const& resource = renderGraph.resources[i];
-			Node node(i, false, resource.manageType != ManageType::Managed, memory_resource);
-			nodes.emplace_back(std::move(node));
+			in_offsets[i + 1] += in_offsets[i];
+			out_offsets[i + 1] += out_offsets[i];
 		}
 
+		auto& ins = ws.ins;
+		auto& outs = ws.outs;
+		ins.resize(in_offsets[nodeCount]);
+		outs.resize(out_offsets[nodeCount]);
+		// offsets of the next free entry of each row, shifted back to the row starts once filled
 		for (index_type_t i = 0; i < passCount; ++i)
 		{
-			auto const& node = nodes[i];
-			for (index_type_t j = 0; j < node.ins.size(); ++j)
+			auto const& pass = renderGraph.passes[i];
+			for (auto edgeIndex : pass.reads)
 			{
-				auto the_in = node.ins[j];
-				nodes[the_in].outs.push_back(i);
+				index_type_t resource = renderGraph.edges[edgeIndex].from + passCount;
+				ins[in_offsets[i]++] = resource;
+				outs[out_offsets[resource]++] = i;
 			}
-			for (index_type_t j = 0; j < node.outs.size(); ++j)
+			for (auto edgeIndex : pass.writes)
 			{
-				auto the_out = node.outs[j];
-				nodes[the_out].ins.push_back(i);
+				index_type_t resource = renderGraph.edges[edgeIndex].to + passCount;
+				outs[out_offsets[i]++] = resource;
+				ins[in_offsets[resource]++] = i;
 			}
 		}
-
-		for (auto i = 0; i < nodes.size(); ++i)
+		for (size_t i = nodeCount; i > 0; --i)
 		{
-			auto& node = nodes[i];
-			node.ref_count = node.outs.size();
+			in_offsets[i] = in_offsets[i - 1];
+			out_offsets[i] = out_offsets[i - 1];
 		}
+		in_offsets[0] = 0;
+		out_offsets[0] = 0;
+
+		auto is_persistent = [&](index_type_t node) -> bool
+			{
+				if (node < passCount)
+					return renderGraph.passes[node].type == PASS_TYPE_PRESENT || renderGraph.passes[node].type == PASS_TYPE_HOLDON;
+				return renderGraph.resources[node - passCount].manageType != ManageType::Managed;
+			};
 
-		std::pmr::vector<index_type_t> cullingStack(memory_resource);
-		cullingStack.reserve(nodes.size());
-		for (auto i = 0; i < nodes.size(); ++i)
+		auto& ref_counts = ws.ref_counts;
+		auto& cullingStack = ws.culling_stack;
+		ref_counts.resize(nodeCount);
+		cullingStack.clear();
+		for (index_type_t i = 0; i < nodeCount; ++i)
 		{
-			auto& node = nodes[i];
-			if (node.ref_count == 0 && !node.is_persistent)
+			ref_counts[i] = out_offsets[i + 1] - out_offsets[i];
+			if (ref_counts[i] == 0 && !is_persistent(i))
 				cullingStack.push_back(i);
 		}
 
@@ -89,44 +794,77 @@ namespace HGEGraphics
 		{
 			auto index = cullingStack.back();
 			cullingStack.pop_back();
-			auto const& node = nodes[index];
 
-			for (auto i = 0; i < node.ins.size(); ++i)
+			for (auto i = in_offsets[index]; i < in_offsets[index + 1]; ++i)
 			{
-				auto inNodeIndex = node.ins[i];
-				auto& inNode = nodes[inNodeIndex];
-				assert(inNode.ref_count > 0);
-				inNode.ref_count--;
-				if (inNode.ref_count == 0 && !inNode.is_persistent)
+				auto inNodeIndex = ins[i];
+				assert(ref_counts[inNodeIndex] > 0);
+				ref_counts[inNodeIndex]--;
+				if (ref_counts[inNodeIndex] == 0 && !is_persistent(inNodeIndex))
 					cullingStack.push_back(inNodeIndex);
 			}
 		}
 
+		auto is_culled = [&](index_type_t node) -> bool
+			{
+				return ref_counts[node] == 0 && !is_persistent(node);
+			};
+
 		CompiledRenderGraph compiled(memory_resource);
-		auto usedPassCount = std::count_if(nodes.begin(), nodes.begin() + passCount, [](auto& node) {return !node.is_culled(); });
-		auto usedResourceCount = std::count_if(nodes.begin() + passCount, nodes.end(), [](auto& node) {return !node.is_culled(); });
+		size_t usedPassCount = 0, usedResourceCount = 0, usedEdgeCount = 0;
+		for (index_type_t i = 0; i < nodeCount; ++i)
+		{
+			if (is_culled(i))
+				continue;
+			if (i < passCount)
+			{
+				++usedPassCount;
+				usedEdgeCount += renderGraph.passes[i].reads.size() + renderGraph.passes[i].writes.size();
+			}
+			else
+				++usedResourceCount;
+		}
+
+		auto& order = ws.order;
+		order.clear();
+		for (index_type_t i = 0; i < passCount; ++i)
+		{
+			if (!is_culled(i))
+				order.push_back(i);
+		}
+		if (schedule == PassSchedule::MinimizeBarriers)
+			schedule_passes(renderGraph, order, memory_resource);
+
+		auto& position = ws.position;
+		position.assign(passCount, MAX_INDEX);
+		for (index_type_t i = 0; i < order.size(); ++i)
+			position[order[i]] = i;
+
 		compiled.passes.reserve(usedPassCount);
-		for (auto i = 0; i < passCount; ++i)
+		compiled.edges.reserve(usedEdgeCount);
+		for (auto passIndex : order)
 		{
-			auto const& node = nodes[i];
-			auto const& pass = renderGraph.passes[node.index];
-			if (!node.is_culled())
+			auto const& pass = renderGraph.passes[passIndex];
 			{
-				auto& compiledPass = compiled.passes.emplace_back(pass.name, memory_resource);
+				auto& compiledPass = compiled.passes.emplace_back(pass.name);
 				compiledPass.type = pass.type;
+				compiledPass.pass_index = passIndex;
+				if (async_compute && pass.type == PASS_TYPE_COMPUTE)
+					compiledPass.queue = pass.compute_context.queue;
 
-				compiledPass.reads.reserve(pass.reads.size());
+				compiledPass.first_edge = compiled.edges.size();
+				compiledPass.read_count = pass.reads.size();
 				for (auto edgeIndex : pass.reads)
 				{
 					auto& edge = renderGraph.edges[edgeIndex];
-					compiledPass.reads.emplace_back(edge.from, edge.usage);
+					compiled.edges.emplace_back(edge.from, edge.usage);
 				}
 
-				compiledPass.writes.reserve(pass.writes.size());
+				compiledPass.write_count = pass.writes.size();
 				for (auto edgeIndex : pass.writes)
 				{
 					auto& edge = renderGraph.edges[edgeIndex];
-					compiledPass.writes.emplace_back(edge.to, edge.usage);
+					compiled.edges.emplace_back(edge.to, edge.usage);
 				}
 
 				if (pass.type == PASS_TYPE_RENDER)
@@ -137,20 +875,11 @@ namespace HGEGraphics
 						compiledPass.colorAttachments[j] = pass.render_context.colorAttachments[j];
 					}
 					compiledPass.depthAttachment = pass.render_context.depthAttachment;
-					compiledPass.executable = pass.render_context.executable;
-				}
-				else if (pass.type == PASS_TYPE_COMPUTE)
-				{
-					compiledPass.executable = pass.compute_context.executable;
 				}
 				else if (pass.type == PASS_TYPE_UPLOAD_TEXTURE)
 				{
 					compiledPass.staging_buffer = pass.upload_texture_context.staging_buffer.index;
 					compiledPass.dest_texture = pass.upload_texture_context.dest_texture.index;
-					compiledPass.uploadTextureExecutable = pass.upload_texture_context.executable;
-					compiledPass.size = pass.upload_texture_context.size;
-					compiledPass.offset = pass.upload_texture_context.offset;
-					compiledPass.data = pass.upload_texture_context.data;
 					compiledPass.mipmap = pass.upload_texture_context.mipmap;
 					compiledPass.slice = pass.upload_texture_context.slice;
 				}
@@ -158,28 +887,22 @@ namespace HGEGraphics
 				{
 					compiledPass.staging_buffer = pass.upload_buffer_context.staging_buffer.index;
 					compiledPass.dest_buffer = pass.upload_buffer_context.dest_buffer.index;
-					compiledPass.uploadTextureExecutable = pass.upload_buffer_context.executable;
-					compiledPass.size = pass.upload_buffer_context.size;
-					compiledPass.offset = pass.upload_buffer_context.offset;
-					compiledPass.data = pass.upload_buffer_context.data;
 				}
-				compiledPass.passdata = pass.passdata;
-			}
-			else
-			{
-				compiled.passes.emplace_back();
+				copy_pass_frame_data(compiledPass, pass);
 			}
 		}
 
+		auto& lifetimes = ws.lifetimes;
+		lifetimes.clear();
 		compiled.resources.reserve(usedResourceCount);
-		for (auto i = 0; i < resourceCount; ++i)
+		for (index_type_t i = 0; i < resourceCount; ++i)
 		{
-			auto const& node = nodes[i + passCount];
-			auto const& resource = renderGraph.resources[node.index];
-			if (!node.is_culled())
+			index_type_t node = i + passCount;
+			auto const& resource = renderGraph.resources[i];
+			if (!is_culled(node))
 			{
 				if (resource.resourceType == ResourceType::Texture)
-					compiled.resources.emplace_back(resource.name, resource.manageType, resource.width, resource.height, resource.depth, resource.format, resource.texture, resource.mipCount, resource.arraySize, resource.parent, resource.mipLevel, resource.arraySlice);
+					compiled.resources.emplace_back(resource.name, resource.manageType, resource.width, resource.height, resource.depth, resource.format, resource.texture, resource.mipCount, resource.arraySize, resource.textureType, resource.parent, resource.mipLevel, resource.arraySlice);
 				else if (resource.resourceType == ResourceType::Buffer)
 					compiled.resources.emplace_back(resource.name, resource.manageType, resource.size, resource.buffer, resource.bufferType, resource.memoryUsage);
 			
@@ -187,23 +910,25 @@ namespace HGEGraphics
 				{
 					index_type_t first = MAX_INDEX;
 					index_type_t last = 0;
-					if (!node.ins.empty())
-					{
-						first = std::min(first, node.ins.front());
-						last = std::max(last, node.ins.back());
-					}
-					if (!node.outs.empty())
-					{
-						first = std::min(first, node.outs.front());
-						last = std::max(last, node.outs.back());
-					}
+					uint32_t queue_mask = 0;
+					auto touch = [&](index_type_t passIndex)
+						{
+							if (position[passIndex] == MAX_INDEX)
+								return;
+							first = std::min(first, position[passIndex]);
+							last = std::max(last, position[passIndex]);
+							queue_mask |= 1 << compiled.passes[position[passIndex]].queue;
+						};
+					for (auto j = in_offsets[node]; j < in_offsets[node + 1]; ++j)
+						touch(ins[j]);
+					for (auto j = out_offsets[node]; j < out_offsets[node + 1]; ++j)
+						touch(outs[j]);
 					if (resource.holdOnLast)
-						last = passCount - 1;
+						last = compiled.passes.size() - 1;
 
 					assert(first >= 0 && first < compiled.passes.size());
-					compiled.passes[first].devirtualize.push_back(i);
 					assert(last >= 0 && last < compiled.passes.size());
-					compiled.passes[last].destroy.push_back(i);
+					lifetimes.push_back({ i, first, last, compiled.passes[first].queue, std::has_single_bit(queue_mask) });
 				}
 			}
 			else
@@ -212,33 +937,223 @@ namespace HGEGraphics
 			}
 		}
 
+		// devirtualized resources grouped by their first pass, followed by the destroyed ones grouped by their last pass
+		auto& lifetime_offsets = ws.lifetime_offsets;
+		lifetime_offsets.assign(compiled.passes.size() * 2, 0);
+		for (auto& lifetime : lifetimes)
+		{
+			compiled.passes[lifetime.first].devirtualize_count++;
+			compiled.passes[lifetime.last].destroy_count++;
+		}
+		uint32_t devirtualize_offset = 0, destroy_offset = lifetimes.size();
+		for (index_type_t i = 0; i < compiled.passes.size(); ++i)
+		{
+			auto& compiledPass = compiled.passes[i];
+			compiledPass.first_devirtualize = lifetime_offsets[i * 2] = devirtualize_offset;
+			compiledPass.first_destroy = lifetime_offsets[i * 2 + 1] = destroy_offset;
+			devirtualize_offset += compiledPass.devirtualize_count;
+			destroy_offset += compiledPass.destroy_count;
+		}
+		compiled.lifetime_resources.resize(lifetimes.size() * 2);
+		for (auto& lifetime : lifetimes)
+		{
+			compiled.lifetime_resources[lifetime_offsets[lifetime.first * 2]++] = lifetime.resource;
+			compiled.lifetime_resources[lifetime_offsets[lifetime.last * 2 + 1]++] = lifetime.resource;
+		}
+
+		build_batches(compiled);
+		plan_transient_aliasing(compiled, lifetimes, compiled.passes.size());
+		infer_attachment_actions(compiled);
+		merge_render_passes(compiled);
+		plan_barriers(compiled);
+
+		compiled.topology_hash = TopologyHash(renderGraph);
+		compiled.schedule = schedule;
+		compiled.async_compute = async_compute;
 		return compiled;
 	}
-	CompiledResourceNode::CompiledResourceNode(const char* name, ManageType type, uint16_t width, uint16_t height, uint16_t depth, ECGPUTextureFormat format, Texture* imported_texture, uint8_t mipCount, uint8_t arraySize, index_type_t parent, uint8_t mipLevel, uint8_t arraySlice)
-		: name(name), resourceType(ResourceType::Texture), manageType(type), width(width), height(height), depth(depth), format(format), imported_texture(imported_texture), imported_buffer(CGPU_NULLPTR), managered_texture(nullptr), size(0), managed_buffer(nullptr), bufferType(CGPU_RESOURCE_TYPE_NONE), memoryUsage(CGPU_MEMORY_USAGE_UNKNOWN)
+	void Compiler::TopologyKey(const rendergraph_t& renderGraph, std::pmr::vector<uint64_t>& key)
+	{
+		key.clear();
+		key.push_back((uint64_t)renderGraph.resources.size());
+		for (auto& resource : renderGraph.resources)
+		{
+			key.push_back((uint64_t)resource.resourceType);
+			key.push_back((uint64_t)resource.manageType);
+			key.push_back((uint64_t)resource.width);
+			key.push_back((uint64_t)resource.height);
+			key.push_back((uint64_t)resource.depth);
+			key.push_back((uint64_t)resource.format);
+			key.push_back((uint64_t)resource.mipCount);
+			key.push_back((uint64_t)resource.arraySize);
+			key.push_back((uint64_t)resource.size);
+			key.push_back((uint64_t)resource.parent);
+			key.push_back((uint64_t)resource.mipLevel);
+			key.push_back((uint64_t)resource.arraySlice);
+			key.push_back((uint64_t)resource.bufferType);
+			key.push_back((uint64_t)resource.textureType);
+			key.push_back((uint64_t)resource.memoryUsage);
+			key.push_back((uint64_t)resource.holdOnLast);
+		}
+
+		key.push_back((uint64_t)renderGraph.edges.size());
+		for (auto& edge : renderGraph.edges)
+		{
+			key.push_back((uint64_t)edge.from);
+			key.push_back((uint64_t)edge.to);
+			key.push_back((uint64_t)edge.usage);
+		}
+
+		key.push_back((uint64_t)renderGraph.passes.size());
+		for (auto& pass : renderGraph.passes)
+		{
+			key.push_back((uint64_t)pass.type);
+			key.push_back((uint64_t)pass.reads.size());
+			for (auto edgeIndex : pass.reads)
+				key.push_back((uint64_t)edgeIndex);
+			key.push_back((uint64_t)pass.writes.size());
+			for (auto edgeIndex : pass.writes)
+				key.push_back((uint64_t)edgeIndex);
+
+			if (pass.type == PASS_TYPE_RENDER)
+			{
+				auto& context = pass.render_context;
+				key.push_back((uint64_t)context.colorAttachmentCount);
+				for (auto j = 0; j < context.colorAttachmentCount; ++j)
+				{
+					key.push_back((uint64_t)context.colorAttachments[j].resourceIndex);
+					key.push_back((uint64_t)context.colorAttachments[j].load_action);
+					key.push_back((uint64_t)context.colorAttachments[j].store_action);
+				}
+				key.push_back((uint64_t)context.depthAttachment.valid);
+				key.push_back((uint64_t)context.depthAttachment.resourceIndex);
+				key.push_back((uint64_t)context.depthAttachment.depth_load_action);
+				key.push_back((uint64_t)context.depthAttachment.depth_store_action);
+				key.push_back((uint64_t)context.depthAttachment.stencil_load_action);
+				key.push_back((uint64_t)context.depthAttachment.stencil_store_action);
+			}
+			else if (pass.type == PASS_TYPE_COMPUTE)
+			{
+				key.push_back((uint64_t)pass.compute_context.queue);
+			}
+			else if (pass.type == PASS_TYPE_UPLOAD_TEXTURE)
+			{
+				key.push_back((uint64_t)pass.upload_texture_context.staging_buffer.index);
+				key.push_back((uint64_t)pass.upload_texture_context.dest_texture.index);
+				key.push_back((uint64_t)pass.upload_texture_context.mipmap);
+				key.push_back((uint64_t)pass.upload_texture_context.slice);
+			}
+			else if (pass.type == PASS_TYPE_UPLOAD_BUFFER)
+			{
+				key.push_back((uint64_t)pass.upload_buffer_context.staging_buffer.index);
+				key.push_back((uint64_t)pass.upload_buffer_context.dest_buffer.index);
+			}
+		}
+	}
+	uint64_t Compiler::TopologyHash(const rendergraph_t& renderGraph)
+	{
+		std::pmr::vector<uint64_t> key(std::pmr::get_default_resource());
+		TopologyKey(renderGraph, key);
+		return fnv1a64(key.data(), sizeof(uint64_t) * key.size());
+	}
+	void Compiler::Patch(CompiledRenderGraph& compiled, const rendergraph_t& renderGraph)
+	{
+		assert(compiled.resources.size() == renderGraph.resources.size());
+
+		for (auto& compiledPass : compiled.passes)
+			copy_pass_frame_data(compiledPass, renderGraph.passes[compiledPass.pass_index]);
+
+		for (size_t i = 0; i < compiled.resources.size(); ++i)
+			copy_resource_frame_data(compiled.resources[i], renderGraph.resources[i]);
+		for (auto& slot : compiled.transient_slots)
+		{
+			slot.texture = nullptr;
+			slot.buffer = nullptr;
+		}
+	}
+	CompiledRenderGraphCache::CompiledRenderGraphCache(uint64_t frame_before_out_of_date, std::pmr::memory_resource* const memory_resource)
+		: memory_resource(memory_resource), entries(memory_resource), key(memory_resource), workspace(memory_resource), frame_before_out_of_date(frame_before_out_of_date)
+	{
+	}
+	CompiledRenderGraph& CompiledRenderGraphCache::compile(const rendergraph_t& renderGraph)
+	{
+		Compiler::TopologyKey(renderGraph, key);
+		key.push_back((uint64_t)schedule);
+		key.push_back((uint64_t)async_compute);
+		uint64_t hash = fnv1a64(key.data(), sizeof(uint64_t) * key.size());
+		auto iter = entries.find(hash);
+		if (iter != entries.end())
+		{
+			auto& entry = iter->second;
+			if (entry.key == key)
+			{
+				++hit_count;
+				entry.timestamp = timestamp;
+				Compiler::Patch(*entry.compiled, renderGraph);
+				return *entry.compiled;
+			}
+
+			std::pmr::polymorphic_allocator<CompiledRenderGraph>(memory_resource).delete_object(entry.compiled);
+			entries.erase(iter);
+		}
+
+		++miss_count;
+		std::pmr::polymorphic_allocator<CompiledRenderGraph> allocator(memory_resource);
+		auto compiled = allocator.new_object<CompiledRenderGraph>(Compiler::Compile(renderGraph, memory_resource, schedule, async_compute, &workspace));
+		entries.emplace(hash, Entry{ compiled, std::pmr::vector<uint64_t>(key, memory_resource), timestamp });
+		return *compiled;
+	}
+	void CompiledRenderGraphCache::newFrame()
+	{
+		++timestamp;
+		std::erase_if(entries, [this](auto& kv) -> bool
+			{
+				bool out_of_date = timestamp > kv.second.timestamp + frame_before_out_of_date;
+				if (out_of_date)
+					std::pmr::polymorphic_allocator<CompiledRenderGraph>(memory_resource).delete_object(kv.second.compiled);
+				return out_of_date;
+			});
+	}
+	void CompiledRenderGraphCache::destroy()
+	{
+		for (auto& [hash, entry] : entries)
+			std::pmr::polymorphic_allocator<CompiledRenderGraph>(memory_resource).delete_object(entry.compiled);
+		entries.clear();
+	}
+	CompiledResourceNode::CompiledResourceNode(const char* name, ManageType type, uint16_t width, uint16_t height, uint16_t depth, ECGPUTextureFormat format, Texture* imported_texture, uint8_t mipCount, uint8_t arraySize, ECGPUResourceTypeFlags textureType, index_type_t parent, uint8_t mipLevel, uint8_t arraySlice)
+		: name(name), resourceType(ResourceType::Texture), manageType(type), width(width), height(height), depth(depth), format(format), imported_texture(imported_texture), imported_buffer(CGPU_NULLPTR), managered_texture(nullptr), size(0), managed_buffer(nullptr), bufferType(CGPU_RESOURCE_TYPE_NONE), textureType(textureType), memoryUsage(CGPU_MEMORY_USAGE_UNKNOWN)
 		, mipCount(mipCount), arraySize(arraySize), parent(parent), mipLevel(mipLevel), arraySlice(arraySlice)
 	{
 	}
 	CompiledResourceNode::CompiledResourceNode(const char* name, ManageType type, uint32_t size, Buffer* imported_buffer, ECGPUResourceTypeFlags bufferType, ECGPUMemoryUsage memoryUsage)
-		: name(name), resourceType(ResourceType::Buffer), manageType(type), size(size), width(0), height(0), depth(0), format(CGPU_TEXTURE_FORMAT_UNDEFINED), imported_texture(CGPU_NULLPTR), imported_buffer(imported_buffer), managered_texture(nullptr), managed_buffer(nullptr), bufferType(bufferType), memoryUsage(memoryUsage)
+		: name(name), resourceType(ResourceType::Buffer), manageType(type), size(size), width(0), height(0), depth(0), format(CGPU_TEXTURE_FORMAT_UNDEFINED), imported_texture(CGPU_NULLPTR), imported_buffer(imported_buffer), managered_texture(nullptr), managed_buffer(nullptr), bufferType(bufferType), textureType(CGPU_RESOURCE_TYPE_NONE), memoryUsage(memoryUsage)
 		, mipCount(0), arraySize(0), parent(0), mipLevel(0), arraySlice(0)
 	{
 	}
 	CompiledResourceNode::CompiledResourceNode()
-		: name(nullptr), resourceType(ResourceType::Texture), manageType(ManageType::Managed), width(0), height(0), depth(0), format(CGPU_TEXTURE_FORMAT_UNDEFINED), imported_texture(nullptr), imported_buffer(CGPU_NULLPTR), managered_texture(nullptr), size(0), managed_buffer(nullptr), bufferType(CGPU_RESOURCE_TYPE_NONE), memoryUsage(CGPU_MEMORY_USAGE_UNKNOWN)
+		: name(nullptr), resourceType(ResourceType::Texture), manageType(ManageType::Managed), width(0), height(0), depth(0), format(CGPU_TEXTURE_FORMAT_UNDEFINED), imported_texture(nullptr), imported_buffer(CGPU_NULLPTR), managered_texture(nullptr), size(0), managed_buffer(nullptr), bufferType(CGPU_RESOURCE_TYPE_NONE), textureType(CGPU_RESOURCE_TYPE_NONE), memoryUsage(CGPU_MEMORY_USAGE_UNKNOWN)
 		, mipCount(0), arraySize(0), parent(0), mipLevel(0), arraySlice(0)
 	{
 	}
-	CompiledRenderPassNode::CompiledRenderPassNode(const char* name, std::pmr::memory_resource* const memory_resource)
-		: name(name), reads(memory_resource), writes(memory_resource)
+	CompiledRenderPassNode::CompiledRenderPassNode(const char* name)
+		: name(name)
 	{
 	}
 	CompiledRenderPassNode::CompiledRenderPassNode()
-		: name(nullptr), type(PASS_TYPE_HOLDON), passdata(nullptr)
+		: name(nullptr), type(PASS_TYPE_HOLDON), pass_index(MAX_INDEX), passdata(nullptr)
 	{
 	}
 	CompiledRenderGraph::CompiledRenderGraph(std::pmr::memory_resource* const memory_resource)
-		: passes(memory_resource), resources(memory_resource)
+		: passes(memory_resource), edges(memory_resource), lifetime_resources(memory_resource), resources(memory_resource), transient_slots(memory_resource), batches(memory_resource), barriers(memory_resource)
+	{
+	}
+	CompilerWorkspace::CompilerWorkspace(std::pmr::memory_resource* const memory_resource)
+		: in_offsets(memory_resource), out_offsets(memory_resource), ins(memory_resource), outs(memory_resource), ref_counts(memory_resource), culling_stack(memory_resource)
+		, order(memory_resource), position(memory_resource), lifetimes(memory_resource), lifetime_offsets(memory_resource)
+	{
+	}
+	CompiledBatch::CompiledBatch(ECGPUQueueType queue, index_type_t first_pass, std::pmr::memory_resource* const memory_resource)
+		: queue(queue), first_pass(first_pass), end_pass(first_pass), acquires(memory_resource), releases(memory_resource)
 	{
 	}
 
@@ -250,7 +1165,7 @@ namespace HGEGraphics
 		return buffer;
 	}
 
-	CGPUTextureViewId rendergraph_resolve_texture_view(RenderPassEncoder* encoder, texture_handle_t texture_handle)
+	CGPUTextureViewId rendergraph_resolve_texture_view(RenderPassEncoder* encoder, texture_handle_t texture_handle, ECGPUTextureViewUsageFlags usage)
 	{
 		auto crg = encoder->compiled_graph;
 		auto& resourceNode = crg->resources[texture_handle.index];
@@ -266,15 +1181,26 @@ namespace HGEGraphics
 			assert(parentResource.parent == 0 && parentResource.resourceType == ResourceType::Texture);
 			texture = parentResource.manageType == ManageType::Managed ? parentResource.managered_texture->texture : parentResource.imported_texture;
 		}
+		bool wholeTexture = resourceNode.manageType != ManageType::SubResource;
+		uint32_t arrayCount = texture->handle->info->array_size_minus_one + 1;
 		desc.texture = texture->handle;
 		desc.format = texture->handle->info->format;
-		desc.usages = CGPU_TEXTURE_VIEW_USAGE_SRV;
+		desc.usages = usage;
 		desc.aspects = CGPU_TEXTURE_VIEW_ASPECT_COLOR;
-		desc.dims = texture->handle->info->depth > 1 ? CGPU_TEXTURE_DIMENSION_3D :  CGPU_TEXTURE_DIMENSION_2D;
+		if (texture->handle->info->depth > 1)
+			desc.dims = CGPU_TEXTURE_DIMENSION_3D;
+		else if (wholeTexture && CGPU_RESOURCE_TYPE_TEXTURE_CUBE == (resourceNode.textureType & CGPU_RESOURCE_TYPE_TEXTURE_CUBE) && usage == CGPU_TEXTURE_VIEW_USAGE_SRV)
+			desc.dims = arrayCount > 6 ? CGPU_TEXTURE_DIMENSION_CUBE_ARRAY : CGPU_TEXTURE_DIMENSION_CUBE;
+		else if (wholeTexture && arrayCount > 1)
+			desc.dims = CGPU_TEXTURE_DIMENSION_2D_ARRAY;
+		else
+			desc.dims = CGPU_TEXTURE_DIMENSION_2D;
 		desc.base_array_layer = resourceNode.arraySlice;
-		desc.array_layer_count = resourceNode.manageType != ManageType::SubResource ? texture->handle->info->array_size_minus_one + 1 : 1;
+		desc.array_layer_count = wholeTexture ? arrayCount : 1;
 		desc.base_mip_level = resourceNode.mipLevel;
-		desc.mip_level_count = resourceNode.manageType != ManageType::SubResource ? texture->handle->info->mip_levels : 1;
+		// storage views see a single mip
+		desc.mip_level_count = wholeTexture && usage == CGPU_TEXTURE_VIEW_USAGE_SRV ? texture->handle->info->mip_levels : 1;
+		std::lock_guard<std::mutex> lock(*encoder->context->pool_mutex);
 		auto textureView = encoder->context->textureViewPool.getResource(desc);
 		return textureView->handle;
 	}
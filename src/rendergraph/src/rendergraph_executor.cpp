@@ -2,14 +2,22 @@
 
 #include "renderer.h"
 #include <cassert>
+#include <algorithm>
+#include <taskflow/taskflow.hpp>
 
 namespace HGEGraphics
 {
 	struct RuntimePass
 	{
 		CompiledRenderPassNode* passNode;
+		CommandRecorder* recorder;
 		RenderPass* renderPass;
 		Framebuffer* framebuffer;
+		CGPURenderPassEncoderId encoder;
+		CGPUStateBufferId state_buffer;
+		CGPURasterStateEncoderId raster_state_encoder;
+		uint32_t width;
+		uint32_t height;
 	};
 
 	Texture* getTexture(std::pmr::vector<CompiledResourceNode>& resources, CompiledResourceNode& resource)
@@ -26,130 +34,129 @@ namespace HGEGraphics
 		}
 	}
 
-	void place_barriers(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, RuntimePass& runtime, CGPUCommandBufferId cmd)
+	// barriers resolved ahead of recording, so chunks of passes can be recorded independently
+	struct PreparedBarriers
 	{
-		uint32_t texture_barrier_count = 0;
-		uint32_t buffer_barrier_count = 0;
-		const size_t length = 16;
-		CGPUTextureBarrier texture_barriers[length];
-		CGPUBufferBarrier buffer_barriers[length];
-		auto place_texture_barriers_impl = [&](decltype(compiledRenderGraph.resources)& resources, const decltype(pass.reads)& edges, CGPUCommandBufferId cmd)
+		std::pmr::vector<CGPUTextureBarrier> textures;
+		std::pmr::vector<CGPUBufferBarrier> buffers;
+	};
+
+	struct BarrierRange
+	{
+		uint32_t first_texture;
+		uint32_t texture_count;
+		uint32_t first_buffer;
+		uint32_t buffer_count;
+	};
+
+	BarrierRange begin_barrier_range(const PreparedBarriers& barriers)
+	{
+		return { (uint32_t)barriers.textures.size(), 0, (uint32_t)barriers.buffers.size(), 0 };
+	}
+
+	void end_barrier_range(const PreparedBarriers& barriers, BarrierRange& range)
+	{
+		range.texture_count = (uint32_t)barriers.textures.size() - range.first_texture;
+		range.buffer_count = (uint32_t)barriers.buffers.size() - range.first_buffer;
+	}
+
+	void record_barriers(const PreparedBarriers& barriers, const BarrierRange& range, CGPUCommandBufferId cmd)
+	{
+		if (range.texture_count == 0 && range.buffer_count == 0)
+			return;
+
+		CGPUResourceBarrierDescriptor barrier_desc = { .buffer_barrier_count = range.buffer_count, .p_buffer_barriers = barriers.buffers.data() + range.first_buffer, .texture_barrier_count = range.texture_count, .p_texture_barriers = barriers.textures.data() + range.first_texture, };
+		cgpu_command_buffer_resource_barrier(cmd, &barrier_desc);
+	}
+
+	// cgpu barriers address either the whole texture or a single subresource, so a partial range goes out one subresource at a time
+	void push_texture_barriers(PreparedBarriers& barriers, Texture* texture, uint32_t first, uint32_t count, ECGPUResourceStateFlags src_state, ECGPUResourceStateFlags dst_state, bool acquire = false, bool release = false, ECGPUQueueType queue = CGPU_QUEUE_TYPE_GRAPHICS)
+	{
+		const auto& states = texture->cur_states;
+		if (first == 0 && count == states.size())
 		{
-			auto add_barrier = [](uint32_t& buffer_barrier_count, CGPUBufferBarrier buffer_barriers[], uint32_t& texture_barrier_count, CGPUTextureBarrier texture_barriers[], CGPUCommandBufferId cmd)
+			barriers.textures.push_back({
+				.texture = texture->handle,
+				.src_state = src_state,
+				.dst_state = dst_state,
+				.queue_acquire = acquire,
+				.queue_release = release,
+				.queue_type = queue,
+				.subresource_barrier = 0,
+				.mip_level = 0,
+				.array_layer = 0,
+				});
+			return;
+		}
+
+		for (auto i = first; i < first + count; ++i)
+		{
+			barriers.textures.push_back({
+				.texture = texture->handle,
+				.src_state = src_state,
+				.dst_state = dst_state,
+				.queue_acquire = acquire,
+				.queue_release = release,
+				.queue_type = queue,
+				.subresource_barrier = 1,
+				.mip_level = uint8_t(i % states.mip_count()),
+				.array_layer = uint8_t(i / states.mip_count()),
+				});
+		}
+	}
+
+	// replay the barriers the compiler planned for a pass, only first uses look at the state the resource is actually in
+	void resolve_barriers(CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, PreparedBarriers& barriers)
+	{
+		auto& resources = compiledRenderGraph.resources;
+		for (auto b = pass.first_barrier; b < pass.first_barrier + pass.barrier_count; ++b)
+		{
+			auto& barrier = compiledRenderGraph.barriers[b];
+			auto& resource = resources[barrier.resource];
+			const auto dst_state = barrier.dst_state;
+			if (resource.resourceType == ResourceType::Texture)
 			{
-				if (texture_barrier_count >= length || buffer_barrier_count >= length)
+				auto texture = getTexture(resources, resource);
+				auto& states = texture->cur_states;
+				const uint32_t first = std::min(barrier.first_subresource, states.size());
+				const uint32_t count = std::min(barrier.subresource_count, states.size() - first);
+				if (!barrier.resolve_src)
 				{
-					CGPUResourceBarrierDescriptor barrier_desc = { .buffer_barrier_count = buffer_barrier_count, .p_buffer_barriers = buffer_barriers, .texture_barrier_count = texture_barrier_count, .p_texture_barriers = texture_barriers, };
-					cgpu_command_buffer_resource_barrier(cmd, &barrier_desc);
-					texture_barrier_count = 0;
-					buffer_barrier_count = 0;
+					push_texture_barriers(barriers, texture, first, count, barrier.src_state, dst_state);
 				}
-			};
-
-			for (auto& edge : edges)
-			{
-				auto& resource = resources[edge.index];
-				if (resource.resourceType == ResourceType::Texture && edge.usage != CGPU_RESOURCE_STATE_UNDEFINED)
+				else
 				{
-					auto texture = getTexture(resources, resource);
-					auto force_barrier = edge.usage == CGPU_RESOURCE_STATE_RENDER_TARGET || edge.usage == CGPU_RESOURCE_STATE_DEPTH_WRITE || edge.usage == CGPU_RESOURCE_STATE_COPY_DEST;
-					if (resource.manageType != ManageType::SubResource)
-					{
-						if (texture->states_consistent == true || texture->cur_states.size() == 1)
+					// a range covering the whole texture stays one barrier if the texture sits in a single state
+					const bool whole = first == 0 && count == states.size() && states.uniform();
+					states.visit(first, count, [&](uint32_t run_first, uint32_t run_count, ECGPUResourceStateFlags src_state)
 						{
-							auto cur_state = texture->cur_states[0];
-							if (cur_state != edge.usage || force_barrier)
-							{
-								texture_barriers[texture_barrier_count++] = {
-									.texture = texture->handle,
-									.src_state = cur_state,
-									.dst_state = edge.usage,
-									.subresource_barrier = 0,
-									.mip_level = 0,
-									.array_layer = 0,
-								};
-								add_barrier(buffer_barrier_count, buffer_barriers, texture_barrier_count, texture_barriers, cmd);
-								for (auto& state : texture->cur_states)
-									state = edge.usage;
-							}
-						}
-						else
-						{
-							for (size_t i = 0; i < texture->cur_states.size(); ++i)
-							{
-								auto& cur_state = texture->cur_states[i];
-								if (cur_state != edge.usage || force_barrier)
-								{
-									texture_barriers[texture_barrier_count++] = {
-										.texture = texture->handle,
-										.src_state = cur_state,
-										.dst_state = edge.usage,
-										.subresource_barrier = 1,
-										.mip_level = uint8_t(i % resource.mipCount),
-										.array_layer = uint8_t(i / resource.mipCount),
-									};
-									add_barrier(buffer_barrier_count, buffer_barriers, texture_barrier_count, texture_barriers, cmd);
-									cur_state = edge.usage;
-								}
-							}
-						}
-						texture->states_consistent = true;
-					}
-					else
-					{
-						auto& cur_state = texture->cur_states[resource.mipLevel + resource.arraySlice * resource.mipCount];
-						if (cur_state != edge.usage || force_barrier)
-						{
-							texture_barriers[texture_barrier_count++] = {
-								.texture = texture->handle,
-								.src_state = cur_state,
-								.dst_state = edge.usage,
-								.subresource_barrier = 1,
-								.mip_level = resource.mipLevel,
-								.array_layer = resource.arraySlice,
-							};
-							add_barrier(buffer_barrier_count, buffer_barriers, texture_barrier_count, texture_barriers, cmd);
-							cur_state = edge.usage;
-							texture->states_consistent = false;
-						}
-					}
+							if (src_state != dst_state || barrier.force)
+								push_texture_barriers(barriers, texture, whole ? 0 : run_first, whole ? states.size() : run_count, src_state, dst_state);
+						});
 				}
-				else if (resource.resourceType == ResourceType::Buffer && edge.usage != CGPU_RESOURCE_STATE_UNDEFINED)
+				states.set(first, count, dst_state);
+			}
+			else if (resource.resourceType == ResourceType::Buffer)
+			{
+				auto buffer = resource.manageType == ManageType::Managed ? resource.managed_buffer->handle : resource.imported_buffer->handle;
+				auto& cur_state = resource.manageType == ManageType::Managed ? resource.managed_buffer->cur_state : resource.imported_buffer->cur_state;
+				auto src_state = barrier.resolve_src ? cur_state : barrier.src_state;
+				if (!barrier.resolve_src || src_state != dst_state || barrier.force)
 				{
-					auto buffer = resource.manageType == ManageType::Managed ? resource.managed_buffer->handle : resource.imported_buffer->handle;
-					auto cur_state = resource.manageType == ManageType::Managed ? resource.managed_buffer->cur_state : resource.imported_buffer->cur_state;
-					auto force_barrier = edge.usage == CGPU_RESOURCE_STATE_COPY_DEST;
-					if (cur_state != edge.usage || force_barrier)
-					{
-						buffer_barriers[buffer_barrier_count++] = {
-							.buffer = buffer,
-							.src_state = cur_state,
-							.dst_state = edge.usage,
-						};
-						add_barrier(buffer_barrier_count, buffer_barriers, texture_barrier_count, texture_barriers, cmd);
-						if (resource.manageType == ManageType::Managed)
-							resource.managed_buffer->cur_state = edge.usage;
-						else
-							resource.imported_buffer->cur_state = edge.usage;
-					}
+					barriers.buffers.push_back({
+						.buffer = buffer,
+						.src_state = src_state,
+						.dst_state = dst_state,
+						});
 				}
+				cur_state = dst_state;
 			}
-		};
-
-		place_texture_barriers_impl(compiledRenderGraph.resources, pass.reads, cmd);
-		place_texture_barriers_impl(compiledRenderGraph.resources, pass.writes, cmd);
-
-		if (texture_barrier_count > 0 || buffer_barrier_count > 0)
-		{
-			CGPUResourceBarrierDescriptor barrier_desc = {.buffer_barrier_count = buffer_barrier_count, .p_buffer_barriers = buffer_barriers, .texture_barrier_count = texture_barrier_count,  .p_texture_barriers = texture_barriers, };
-			cgpu_command_buffer_resource_barrier(cmd, &barrier_desc);
-			texture_barrier_count = 0;
-			buffer_barrier_count = 0;
 		}
 	}
 
-	void execute_render_pass(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, RuntimePass& runtime, CGPUCommandBufferId cmd)
+	void begin_render_pass(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, RuntimePass& runtime, CGPUCommandBufferId cmd)
 	{
+		runtime.encoder = CGPU_NULLPTR;
 		int attachment_count = pass.colorAttachmentCount + (pass.depthAttachment.valid ? 1 : 0);
 		if (attachment_count > 0)
 		{
@@ -177,7 +184,12 @@ namespace HGEGraphics
 				};
 			}
 
-			runtime.renderPass = context.renderPassPool.getRenderPass(rpDesc);
+			{
+				std::lock_guard<std::mutex> lock(*context.pipeline_mutex);
+				runtime.renderPass = context.renderPassPool.getRenderPass(rpDesc);
+			}
+			// the pools are shared by every recording thread
+			std::unique_lock<std::mutex> lock(*context.pool_mutex);
 			CGPUFramebufferDescriptor fbDesc = {};
 			fbDesc.renderpass = runtime.renderPass->renderPass;
 			fbDesc.attachment_count = pass.colorAttachmentCount + (pass.depthAttachment.valid ? 1 : 0);
@@ -192,7 +204,7 @@ namespace HGEGraphics
 				desc.usages = CGPU_TEXTURE_VIEW_USAGE_RTV_DSV;
 				desc.aspects = CGPU_TEXTURE_VIEW_ASPECT_COLOR;
 				desc.dims = CGPU_TEXTURE_DIMENSION_2D;
-				desc.base_array_layer = 0;
+				desc.base_array_layer = resource.arraySlice;
 				desc.array_layer_count = 1;
 				desc.base_mip_level = resource.mipLevel;
 				desc.mip_level_count = 1;
@@ -210,7 +222,7 @@ namespace HGEGraphics
 				desc.usages = CGPU_TEXTURE_VIEW_USAGE_RTV_DSV;
 				desc.aspects = CGPU_TEXTURE_VIEW_ASPECT_DEPTH | CGPU_TEXTURE_VIEW_ASPECT_STENCIL;
 				desc.dims = CGPU_TEXTURE_DIMENSION_2D;
-				desc.base_array_layer = 0;
+				desc.base_array_layer = resource.arraySlice;
 				desc.array_layer_count = 1;
 				desc.base_mip_level = resource.mipLevel;
 				desc.mip_level_count = 1;
@@ -223,6 +235,7 @@ namespace HGEGraphics
 			fbDesc.height = mipedSize(fbDesc.p_attachments[0]->info.texture->info->height, fbDesc.p_attachments[0]->info.base_mip_level);
 			fbDesc.layers = 1;
 			runtime.framebuffer = context.framebufferPool.getFramebuffer(fbDesc);
+			lock.unlock();
 
 			CGPUClearValue clear_values[9];
 
@@ -264,41 +277,61 @@ namespace HGEGraphics
 				.clear_value_count = clear_value_count,
 				.p_clear_values = clear_values,
 			};
-			auto encoder = cgpu_command_buffer_begin_render_pass(cmd, &begin);
-			auto state_buffer = cgpu_command_buffer_create_state_buffer(cmd, nullptr);
-			cgpu_render_pass_encoder_bind_state_buffer(encoder, state_buffer);
-			auto raster_state_encoder = cgpu_state_buffer_open_raster_state_encoder(state_buffer, encoder);
-
-			cgpu_render_pass_encoder_set_viewport(encoder,
-				0.0f, 0.0f,
-				(float)fbDesc.width, (float)fbDesc.height,
-				0.f, 1.f);
-			cgpu_render_pass_encoder_set_scissor(encoder, 0, 0, fbDesc.width, fbDesc.height);
-			if (context.support_shading_rate)
-				cgpu_render_pass_encoder_set_shading_rate(encoder, CGPU_SHADING_RATE_FULL, CGPU_SHADING_RATE_COMBINER_PASS_THROUGH, CGPU_SHADING_RATE_COMBINER_PASS_THROUGH);
-
-			if (pass.executable)
-			{
-				RenderPassEncoder rg_encoder = {
-					.encoder = encoder,
-					.state_buffer = state_buffer,
-					.raster_state_encoder = raster_state_encoder,
-					.render_pass = runtime.renderPass->renderPass,
-					.subpass = 0,
-					.render_target_count = (uint32_t)pass.colorAttachmentCount,
-					.context = &context,
-					.compiled_graph = &compiledRenderGraph,
-					.last_render_pipeline = 0,
-					.last_bind_resources = {0},
-				};
-				pass.executable(&rg_encoder, pass.passdata);
-			}
+			runtime.encoder = cgpu_command_buffer_begin_render_pass(cmd, &begin);
+			runtime.state_buffer = cgpu_command_buffer_create_state_buffer(cmd, nullptr);
+			cgpu_render_pass_encoder_bind_state_buffer(runtime.encoder, runtime.state_buffer);
+			runtime.raster_state_encoder = cgpu_state_buffer_open_raster_state_encoder(runtime.state_buffer, runtime.encoder);
+			// a bucketed texture can be larger than the graph asked for, draws keep to the asked size
+			auto& firstResource = compiledRenderGraph.resources[pass.colorAttachmentCount > 0 ? pass.colorAttachments[0].resourceIndex : pass.depthAttachment.resourceIndex];
+			auto& rootResource = firstResource.manageType == ManageType::SubResource ? compiledRenderGraph.resources[firstResource.parent] : firstResource;
+			runtime.width = std::min<uint32_t>(fbDesc.width, mipedSize(rootResource.width, firstResource.mipLevel));
+			runtime.height = std::min<uint32_t>(fbDesc.height, mipedSize(rootResource.height, firstResource.mipLevel));
+		}
+	}
 
-			cgpu_state_buffer_close_raster_state_encoder(state_buffer, raster_state_encoder);
-			cgpu_command_buffer_free_state_buffer(cmd, state_buffer);
-			cgpu_command_buffer_end_render_pass(cmd, encoder);
+	void end_render_pass(ExecutorContext& context, RuntimePass& runtime, CGPUCommandBufferId cmd)
+	{
+		cgpu_state_buffer_close_raster_state_encoder(runtime.state_buffer, runtime.raster_state_encoder);
+		cgpu_command_buffer_free_state_buffer(cmd, runtime.state_buffer);
+		cgpu_command_buffer_end_render_pass(cmd, runtime.encoder);
+		runtime.encoder = CGPU_NULLPTR;
+	}
+
+	void execute_render_pass(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, RuntimePass& runtime, CGPUCommandBufferId cmd)
+	{
+		if (!pass.merge_with_previous)
+			begin_render_pass(context, compiledRenderGraph, pass, runtime, cmd);
+		if (!runtime.encoder)
+			return;
+
+		cgpu_render_pass_encoder_set_viewport(runtime.encoder,
+			0.0f, 0.0f,
+			(float)runtime.width, (float)runtime.height,
+			0.f, 1.f);
+		cgpu_render_pass_encoder_set_scissor(runtime.encoder, 0, 0, runtime.width, runtime.height);
+		if (context.support_shading_rate)
+			cgpu_render_pass_encoder_set_shading_rate(runtime.encoder, CGPU_SHADING_RATE_FULL, CGPU_SHADING_RATE_COMBINER_PASS_THROUGH, CGPU_SHADING_RATE_COMBINER_PASS_THROUGH);
+
+		if (pass.executable)
+		{
+			RenderPassEncoder rg_encoder = {
+				.encoder = runtime.encoder,
+				.state_buffer = runtime.state_buffer,
+				.raster_state_encoder = runtime.raster_state_encoder,
+				.render_pass = runtime.renderPass->renderPass,
+				.render_pass_resource = runtime.renderPass,
+				.subpass = 0,
+				.render_target_count = (uint32_t)pass.colorAttachmentCount,
+				.context = &context,
+				.recorder = runtime.recorder,
+				.compiled_graph = &compiledRenderGraph,
+				.last_render_pipeline = 0,
+			};
+			pass.executable(&rg_encoder, pass.passdata);
 		}
 
+		if (!pass.merge_with_next)
+			end_render_pass(context, runtime, cmd);
 	}
 
 	void execute_compute_pass(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, RuntimePass& runtime, CGPUCommandBufferId cmd)
@@ -314,9 +347,9 @@ namespace HGEGraphics
 			RenderPassEncoder rg_encoder = {
 				.compute_encoder = encoder,
 				.context = &context,
+				.recorder = runtime.recorder,
 				.compiled_graph = &compiledRenderGraph,
 				.last_render_pipeline = 0,
-				.last_bind_resources = {0},
 			};
 			pass.executable(&rg_encoder, pass.passdata);
 		}
@@ -387,56 +420,182 @@ namespace HGEGraphics
 		b2b.src_offset = 0;
 		b2b.dst = dest_buffer;
 		b2b.dst_offset = 0;
-		b2b.size = dest_buffer->info->size;
+		b2b.size = dest_resource_node.size;
 		cgpu_command_buffer_transfer_buffer_to_buffer(cmd, &b2b);
 	}
 
-	void Executor::Execute(CompiledRenderGraph& compiledRenderGraph, ExecutorContext& context)
+	void queue_transfer_barriers(CompiledRenderGraph& compiledRenderGraph, const std::pmr::vector<QueueTransfer>& transfers, bool acquire, PreparedBarriers& barriers)
 	{
-		auto cmd = context.requestCmd();
-
-		cgpu_command_buffer_begin(cmd);
-
-		if (context.profiler)
+		// only ownership moves, the state stays and the consumer's own barrier transitions it afterwards
+		for (auto& transfer : transfers)
 		{
-			context.profiler->CollectTimings();
-			context.profiler->OnBeginFrame(cmd);
+			auto& resource = compiledRenderGraph.resources[transfer.resource];
+			if (resource.resourceType == ResourceType::Texture)
+			{
+				auto texture = getTexture(compiledRenderGraph.resources, resource);
+				texture->cur_states.visit(0, texture->cur_states.size(), [&](uint32_t first, uint32_t count, ECGPUResourceStateFlags state)
+					{
+						if (state != CGPU_RESOURCE_STATE_UNDEFINED)
+							push_texture_barriers(barriers, texture, first, count, state, state, acquire, !acquire, transfer.queue);
+					});
+			}
+			else if (resource.resourceType == ResourceType::Buffer)
+			{
+				auto buffer = resource.manageType == ManageType::Managed ? resource.managed_buffer->handle : resource.imported_buffer->handle;
+				auto state = resource.manageType == ManageType::Managed ? resource.managed_buffer->cur_state : resource.imported_buffer->cur_state;
+				if (state == CGPU_RESOURCE_STATE_UNDEFINED)
+					continue;
+				barriers.buffers.push_back({
+					.buffer = buffer,
+					.src_state = state,
+					.dst_state = state,
+					.queue_acquire = acquire,
+					.queue_release = !acquire,
+					.queue_type = transfer.queue,
+					});
+			}
 		}
+	}
 
-		for (auto i = 0; i < compiledRenderGraph.passes.size(); ++i)
+	void devirtualize_resources(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass)
+	{
+		for (auto resourceIndex : compiledRenderGraph.devirtualized(pass))
 		{
-			auto& pass = compiledRenderGraph.passes[i];
-
-			RuntimePass runtime = {};
-			runtime.passNode = &pass;
-
-			for (auto resourceIndex : pass.devirtualize)
+			auto& resource = compiledRenderGraph.resources[resourceIndex];
+			if (resource.resourceType == ResourceType::Texture)
 			{
-				auto& resource = compiledRenderGraph.resources[resourceIndex];
-				if (resource.resourceType == ResourceType::Texture)
+				if (resource.manageType == ManageType::Managed)
 				{
-					if (resource.manageType == ManageType::Managed)
+					auto& slot = compiledRenderGraph.transient_slots[resource.alias_slot];
+					if (slot.texture == nullptr)
 					{
-						resource.managered_texture = context.texturePool.getTexture(resource.width, resource.height, resource.depth, resource.format);
+						TextureDescriptor desc =
+						{
+							.width = resource.width,
+							.height = resource.height,
+							.depth = resource.depth,
+							.mipLevels = resource.mipCount,
+							.arraySize = resource.arraySize,
+							.format = resource.format,
+							.descriptors = resource.textureType,
+						};
+						slot.texture = context.texturePool.getTexture(desc);
 					}
+					resource.managered_texture = slot.texture;
 				}
-				else if (resource.resourceType == ResourceType::Buffer)
+			}
+			else if (resource.resourceType == ResourceType::Buffer)
+			{
+				if (resource.manageType == ManageType::Managed)
 				{
-					if (resource.manageType == ManageType::Managed)
+					auto& slot = compiledRenderGraph.transient_slots[resource.alias_slot];
+					if (slot.buffer == nullptr)
 					{
 						CGPUBufferDescriptor desc = {};
 						desc.name = resource.name;
 						desc.flags = resource.memoryUsage != CGPU_MEMORY_USAGE_GPU_ONLY ? CGPU_BUFFER_CREATION_USAGE_PERSISTENT_MAP : CGPU_BUFFER_CREATION_USAGE_NONE;
 						desc.descriptors = resource.bufferType;
 						desc.memory_usage = resource.memoryUsage;
-						desc.size = resource.size;
+						desc.size = slot.size;
 
-						resource.managed_buffer = context.bufferPool.getResource(desc);
+						slot.buffer = context.bufferPool.getResource(desc);
 					}
+					resource.managed_buffer = slot.buffer;
 				}
 			}
+		}
+	}
+
+	void release_resources(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const CompiledRenderPassNode& pass, bool defer_release)
+	{
+		for (auto resourceIndex : compiledRenderGraph.destroyed(pass))
+		{
+			auto& resource = compiledRenderGraph.resources[resourceIndex];
+			if (resource.manageType != ManageType::Managed)
+				continue;
+
+			// the slot goes back to the pool with its last occupant
+			auto& slot = compiledRenderGraph.transient_slots[resource.alias_slot];
+			if (slot.last_resource != resourceIndex || defer_release)
+				continue;
+
+			if (resource.resourceType == ResourceType::Texture)
+			{
+				context.texturePool.releaseResource(slot.texture);
+				slot.texture = nullptr;
+			}
+			else if (resource.resourceType == ResourceType::Buffer)
+			{
+				context.bufferPool.releaseResource(slot.buffer);
+				slot.buffer = nullptr;
+			}
+		}
+	}
+
+	struct PreparedPass
+	{
+		BarrierRange barriers;
+		uint32_t timestamp;
+	};
 
-			place_barriers(context, compiledRenderGraph, pass, runtime, cmd);
+	struct PreparedBatch
+	{
+		BarrierRange acquires;
+		BarrierRange releases;
+	};
+
+	// a run of passes of one batch, recorded into its own command buffer
+	struct RecordChunk
+	{
+		index_type_t batch;
+		index_type_t first_pass;
+		index_type_t end_pass;
+		CommandRecorder* recorder;
+		CGPUCommandBufferId cmd;
+	};
+
+	struct PreparedFrame
+	{
+		PreparedBarriers barriers;
+		std::pmr::vector<PreparedPass> passes;
+		std::pmr::vector<PreparedBatch> batches;
+		std::pmr::vector<RecordChunk> chunks;
+		uint32_t begin_timestamp;
+	};
+
+	// below this many passes a chunk costs more in command buffer overhead than it saves
+	const index_type_t min_passes_per_chunk = 4;
+
+	void record_chunk(ExecutorContext& context, CompiledRenderGraph& compiledRenderGraph, const PreparedFrame& frame, size_t chunk_index)
+	{
+		auto& chunk = frame.chunks[chunk_index];
+		auto& batch = compiledRenderGraph.batches[chunk.batch];
+		const bool graphics = batch.queue == CGPU_QUEUE_TYPE_GRAPHICS;
+		const bool first_of_batch = chunk_index == 0 || frame.chunks[chunk_index - 1].batch != chunk.batch;
+		const bool last_of_batch = chunk_index + 1 == frame.chunks.size() || frame.chunks[chunk_index + 1].batch != chunk.batch;
+		auto cmd = chunk.cmd;
+
+		cgpu_command_buffer_begin(cmd);
+
+		if (context.profiler && chunk_index == 0)
+		{
+			context.profiler->ResetQueries(cmd);
+			context.profiler->WriteTimeStamp(cmd, frame.begin_timestamp);
+		}
+
+		if (first_of_batch)
+			record_barriers(frame.barriers, frame.batches[chunk.batch].acquires, cmd);
+
+		RuntimePass runtime = {};
+		runtime.recorder = chunk.recorder;
+		for (auto i = chunk.first_pass; i < chunk.end_pass; ++i)
+		{
+			auto& pass = compiledRenderGraph.passes[i];
+			runtime.passNode = &pass;
+
+			// bindings only live for the pass that set them
+			chunk.recorder->clearBindings();
+			record_barriers(frame.barriers, frame.passes[i].barriers, cmd);
 			if (pass.type == PASS_TYPE_RENDER)
 			{
 				execute_render_pass(context, compiledRenderGraph, pass, runtime, cmd);
@@ -454,25 +613,150 @@ namespace HGEGraphics
 				execute_upload_buffer_pass(context, compiledRenderGraph, pass, runtime, cmd);
 			}
 
-			for (auto resourceIndex : pass.destroy)
+			if (context.profiler && graphics)context.profiler->WriteTimeStamp(cmd, frame.passes[i].timestamp);
+		}
+
+		if (last_of_batch)
+			record_barriers(frame.barriers, frame.batches[chunk.batch].releases, cmd);
+
+		if (context.profiler && chunk_index + 1 == frame.chunks.size())context.profiler->OnEndFrame(cmd);
+		cgpu_command_buffer_end(cmd);
+	}
+
+	void Executor::Execute(CompiledRenderGraph& compiledRenderGraph, ExecutorContext& context, tf::Executor* taskExecutor)
+	{
+		// with several queues in flight a resource only goes back to the pool once the whole frame is prepared,
+		// otherwise the pool could hand it to a pass running concurrently on the other queue
+		const bool defer_release = compiledRenderGraph.batches.size() > 1;
+		const size_t first_submit = context.submit_batches.size();
+		auto& passes = compiledRenderGraph.passes;
+		auto& batches = compiledRenderGraph.batches;
+
+		PreparedFrame frame = {
+			.barriers = { std::pmr::vector<CGPUTextureBarrier>(context.memory_resource), std::pmr::vector<CGPUBufferBarrier>(context.memory_resource) },
+			.passes = std::pmr::vector<PreparedPass>(passes.size(), context.memory_resource),
+			.batches = std::pmr::vector<PreparedBatch>(batches.size(), context.memory_resource),
+			.chunks = std::pmr::vector<RecordChunk>(context.memory_resource),
+			.begin_timestamp = 0,
+		};
+
+		if (context.profiler)
+		{
+			context.profiler->CollectTimings();
+			context.profiler->ClearTimeStamps();
+			frame.begin_timestamp = context.profiler->ReserveTimeStamp("Begin Frame");
+		}
+
+		// resources are devirtualized and their barriers resolved in frame order, recording only replays them
+		for (index_type_t b = 0; b < batches.size(); ++b)
+		{
+			auto& batch = batches[b];
+			auto& prepared_batch = frame.batches[b];
+
+			prepared_batch.acquires = begin_barrier_range(frame.barriers);
+			queue_transfer_barriers(compiledRenderGraph, batch.acquires, true, frame.barriers);
+			end_barrier_range(frame.barriers, prepared_batch.acquires);
+
+			for (auto i = batch.first_pass; i < batch.end_pass; ++i)
 			{
-				auto& resource = compiledRenderGraph.resources[resourceIndex];
-				if (resource.resourceType == ResourceType::Texture)
-				{
-					if (resource.manageType == ManageType::Managed)
-						context.texturePool.releaseResource(resource.managered_texture);
-				}
-				else if (resource.resourceType == ResourceType::Buffer)
-				{
-					if (resource.manageType == ManageType::Managed)
-						context.bufferPool.releaseResource(resource.managed_buffer);
-				}
+				auto& pass = passes[i];
+				auto& prepared = frame.passes[i];
+
+				devirtualize_resources(context, compiledRenderGraph, pass);
+
+				prepared.barriers = begin_barrier_range(frame.barriers);
+				resolve_barriers(compiledRenderGraph, pass, frame.barriers);
+				end_barrier_range(frame.barriers, prepared.barriers);
+
+				release_resources(context, compiledRenderGraph, pass, defer_release);
+
+				if (context.profiler && batch.queue == CGPU_QUEUE_TYPE_GRAPHICS)
+					prepared.timestamp = context.profiler->ReserveTimeStamp(pass.name);
 			}
 
-			if (context.profiler)context.profiler->GetTimeStamp(cmd, pass.name);
+			prepared_batch.releases = begin_barrier_range(frame.barriers);
+			queue_transfer_barriers(compiledRenderGraph, batch.releases, false, frame.barriers);
+			end_barrier_range(frame.barriers, prepared_batch.releases);
 		}
 
-		if (context.profiler)context.profiler->OnEndFrame(cmd);
-		cgpu_command_buffer_end(cmd);
+		auto& report = compiledRenderGraph.barrier_report;
+		report.recorded_barriers = frame.barriers.textures.size() + frame.barriers.buffers.size();
+		report.barrier_calls = 0;
+		auto count_call = [&](const BarrierRange& range) { report.barrier_calls += range.texture_count > 0 || range.buffer_count > 0; };
+		for (auto& prepared : frame.passes)
+			count_call(prepared.barriers);
+		for (auto& prepared : frame.batches)
+		{
+			count_call(prepared.acquires);
+			count_call(prepared.releases);
+		}
+
+		// chunks never split a batch or a merged render pass chain, every batch gets at least one
+		const size_t worker_count = taskExecutor ? std::max<size_t>(taskExecutor->num_workers(), 1) : 1;
+		for (index_type_t b = 0; b < batches.size(); ++b)
+		{
+			auto& batch = batches[b];
+			const index_type_t pass_count = batch.end_pass - batch.first_pass;
+			const index_type_t chunk_size = std::max<index_type_t>((pass_count + worker_count - 1) / worker_count, min_passes_per_chunk);
+			const size_t first_cmd = context.submit_cmds.size();
+			auto first = batch.first_pass;
+			do
+			{
+				auto end = std::min<index_type_t>(first + chunk_size, batch.end_pass);
+				while (end < batch.end_pass && passes[end].merge_with_previous)
+					++end;
+
+				auto recorder = context.requestRecorder(frame.chunks.size());
+				auto cmd = recorder->requestCmd(batch.queue);
+				frame.chunks.push_back({ b, first, end, recorder, cmd });
+				context.submit_cmds.push_back(cmd);
+				first = end;
+			} while (first < batch.end_pass);
+
+			context.submit_batches.push_back({
+				.queue = batch.queue,
+				.first_cmd = (uint32_t)first_cmd,
+				.cmd_count = uint32_t(context.submit_cmds.size() - first_cmd),
+				.wait_semaphore = CGPU_NULLPTR,
+				.signal_semaphore = batch.signal ? context.requestSemaphore() : CGPU_NULLPTR,
+				});
+		}
+
+		if (taskExecutor && frame.chunks.size() > 1)
+		{
+			tf::Taskflow taskflow;
+			for (size_t c = 0; c < frame.chunks.size(); ++c)
+				taskflow.emplace([&context, &compiledRenderGraph, &frame, c]() { record_chunk(context, compiledRenderGraph, frame, c); });
+			// a worker of the same executor has to help out instead of blocking on the flow
+			if (taskExecutor->this_worker_id() >= 0)
+				taskExecutor->corun(taskflow);
+			else
+				taskExecutor->run(taskflow).wait();
+		}
+		else
+		{
+			for (size_t c = 0; c < frame.chunks.size(); ++c)
+				record_chunk(context, compiledRenderGraph, frame, c);
+		}
+
+		for (index_type_t b = 0; b < batches.size(); ++b)
+		{
+			auto wait_batch = batches[b].wait_batch;
+			if (wait_batch != MAX_INDEX)
+				context.submit_batches[first_submit + b].wait_semaphore = context.submit_batches[first_submit + wait_batch].signal_semaphore;
+		}
+
+		if (defer_release)
+		{
+			for (auto& slot : compiledRenderGraph.transient_slots)
+			{
+				if (slot.texture)
+					context.texturePool.releaseResource(slot.texture);
+				if (slot.buffer)
+					context.bufferPool.releaseResource(slot.buffer);
+				slot.texture = nullptr;
+				slot.buffer = nullptr;
+			}
+		}
 	}
 }
\ No newline at end of file
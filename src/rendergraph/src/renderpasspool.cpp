@@ -2,8 +2,8 @@
 
 namespace HGEGraphics
 {
-	RenerPassPool::RenerPassPool(CGPUDeviceId device, std::pmr::memory_resource* const memory_resource)
-		: ResourcePool(12, nullptr, memory_resource), device(device), allocator(memory_resource)
+	RenerPassPool::RenerPassPool(CGPUDeviceId device, RenerPassPool* upstream, std::pmr::memory_resource* const memory_resource)
+		: ResourcePool(12, upstream, memory_resource), device(device), allocator(memory_resource)
 	{
 	}
 	RenderPass* RenerPassPool::getRenderPass(const CGPURenderPassDescriptor& descriptor)
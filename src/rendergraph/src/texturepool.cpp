@@ -1,5 +1,7 @@
 #include "texturepool.h"
 #include "renderer.h"
+#include <algorithm>
+#include <cassert>
 
 namespace HGEGraphics
 {
@@ -7,7 +9,8 @@ namespace HGEGraphics
 	{
 		return width == other.width && height == other.height
 			&& depth == other.depth && mipLevels == other.mipLevels
-			&& format == other.format;
+			&& arraySize == other.arraySize && format == other.format
+			&& descriptors == other.descriptors;
 	}
 
 	TexturePool::TexturePool(TexturePool* upstream, std::pmr::memory_resource* const memory_resource)
@@ -17,12 +20,52 @@ namespace HGEGraphics
 
 	TextureWrap* TexturePool::getTexture(uint16_t width, uint16_t height, uint16_t depth, ECGPUTextureFormat format)
 	{
-		TextureDescriptor key = { width, height, depth, 1, format };
-		return getResource(key);
+		TextureDescriptor key = { .width = width, .height = height, .depth = depth, .mipLevels = 1, .arraySize = 1, .format = format };
+		return getTexture(key);
+	}
+	TextureWrap* TexturePool::getTexture(const TextureDescriptor& descriptor)
+	{
+		return getResource(bucketed(descriptor));
+	}
+	void TexturePool::setSizeBucketing(uint16_t granularity)
+	{
+		size_granularity = granularity;
+	}
+	TextureDescriptor TexturePool::bucketed(const TextureDescriptor& descriptor) const
+	{
+		if (size_granularity <= 1)
+			return descriptor;
+		auto roundUp = [this](uint32_t size) { return (uint16_t)std::min<uint32_t>((size + size_granularity - 1) / size_granularity * size_granularity, UINT16_MAX); };
+		TextureDescriptor key = descriptor;
+		key.width = roundUp(descriptor.width);
+		key.height = roundUp(descriptor.height);
+		return key;
+	}
+	uint64_t TexturePool::resourceSize(const TextureDescriptor& descriptor) const
+	{
+		auto mipedSize = [](uint64_t size, uint64_t mip) { return std::max<uint64_t>(size >> mip, 1ull); };
+		uint64_t size = 0;
+		uint32_t mipCount = std::max<uint32_t>(descriptor.mipLevels, 1);
+		for (uint32_t mip = 0; mip < mipCount; ++mip)
+		{
+			const uint64_t xBlocksCount = (mipedSize(descriptor.width, mip) + FormatUtil_WidthOfBlock(descriptor.format) - 1) / FormatUtil_WidthOfBlock(descriptor.format);
+			const uint64_t yBlocksCount = (mipedSize(descriptor.height, mip) + FormatUtil_HeightOfBlock(descriptor.format) - 1) / FormatUtil_HeightOfBlock(descriptor.format);
+			const uint64_t zBlocksCount = mipedSize(descriptor.depth, mip);
+			size += xBlocksCount * yBlocksCount * zBlocksCount * FormatUtil_BitSizeOfBlock(descriptor.format) / 8;
+		}
+		return size * std::max<uint32_t>(descriptor.arraySize, 1);
 	}
 	CgpuTexturePool::CgpuTexturePool(CGPUDeviceId device, CGPUQueueId gfx_queue, TexturePool* upstream, std::pmr::memory_resource* const memory_resource)
-		: TexturePool(upstream, memory_resource), device(device), gfx_queue(gfx_queue), allocator(memory_resource)
+		: TexturePool(upstream, memory_resource), device(device), gfx_queue(gfx_queue), allocator(memory_resource), dependent_contexts(memory_resource)
+	{
+	}
+	void CgpuTexturePool::addDependentContext(ExecutorContext* context)
+	{
+		dependent_contexts.push_back(context);
+	}
+	void CgpuTexturePool::removeDependentContext(ExecutorContext* context)
 	{
+		std::erase(dependent_contexts, context);
 	}
 	TextureWrap* CgpuTexturePool::getResource_impl(const TextureDescriptor& descriptor)
 	{
@@ -33,18 +76,21 @@ namespace HGEGraphics
 			descriptor.format == CGPU_TEXTURE_FORMAT_D32_SFLOAT ||
 			descriptor.format == CGPU_TEXTURE_FORMAT_X8_D24_UNORM_PACK32 ||
 			descriptor.format == CGPU_TEXTURE_FORMAT_D16_UNORM;
+		auto descriptors = CGPU_RESOURCE_TYPE_TEXTURE | (isDepth ? CGPU_RESOURCE_TYPE_DEPTH_STENCIL : CGPU_RESOURCE_TYPE_RENDER_TARGET) | descriptor.descriptors;
+		bool isCube = CGPU_RESOURCE_TYPE_TEXTURE_CUBE == (descriptor.descriptors & CGPU_RESOURCE_TYPE_TEXTURE_CUBE);
+		assert(!isCube || (descriptor.width == descriptor.height && descriptor.depth == 1 && descriptor.arraySize % 6 == 0));
 		CGPUTextureDescriptor texture_desc =
 		{
-			.flags = CGPU_TEXTURE_CREATION_USAGE_FORCE2D,
+			.flags = descriptor.depth > 1 ? CGPU_TEXTURE_CREATION_USAGE_NONE : CGPU_TEXTURE_CREATION_USAGE_FORCE2D,
 			.width = descriptor.width,
 			.height = descriptor.height,
 			.depth = descriptor.depth,
-			.array_size = 1,
+			.array_size = std::max<uint32_t>(descriptor.arraySize, 1),
 			.format = descriptor.format,
-			.mip_levels = 1,
+			.mip_levels = std::max<uint32_t>(descriptor.mipLevels, 1),
 			.owner_queue = gfx_queue,
 			.start_state = CGPU_RESOURCE_STATE_UNDEFINED,
-			.descriptors = (ECGPUResourceTypeFlags)(CGPU_RESOURCE_TYPE_TEXTURE | (isDepth ? CGPU_RESOURCE_TYPE_DEPTH_STENCIL : CGPU_RESOURCE_TYPE_RENDER_TARGET)),
+			.descriptors = (ECGPUResourceTypeFlags)descriptors,
 		};
 
 		auto texture = cgpu_device_create_texture(device, &texture_desc);
@@ -54,13 +100,13 @@ namespace HGEGraphics
 		resource->texture = allocator.new_object<Texture>();
 		resource->texture->handle = texture;
 		resource->texture->view = nullptr;
-		resource->texture->cur_states.resize(descriptor.depth * descriptor.mipLevels);
-		std::fill(resource->texture->cur_states.begin(), resource->texture->cur_states.end(), CGPU_RESOURCE_STATE_UNDEFINED);
-		resource->texture->states_consistent = true;
+		resource->texture->cur_states.reset(texture_desc.mip_levels, texture_desc.array_size, CGPU_RESOURCE_STATE_UNDEFINED);
 		return resource;
 	}
 	void CgpuTexturePool::destroyResource_impl(TextureWrap* resource)
 	{
+		for (auto context : dependent_contexts)
+			context->forgetTexture(resource->texture->handle);
 		cgpu_device_free_texture(device, resource->texture->handle);
 		resource->texture->handle = CGPU_NULLPTR;
 		resource->texture->cur_states.clear();
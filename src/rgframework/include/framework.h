@@ -2,6 +2,7 @@
 
 #include "stdint.h"
 #include "rendergraph.h"
+#include "rendergraph_compiler.h"
 #include "drawer.h"
 #include "HandmadeMath.h"
 #include <taskflow/taskflow.hpp>
@@ -68,6 +69,18 @@ typedef struct oval_device_descriptor
     bool enable_capture;
     bool enable_profile;
     bool enable_gpu_validation;
+    bool reorder_passes;
+    bool async_compute;
+    // compile pipelines missing at draw time on the task workers, draws use the shader's fallback or are skipped until then
+    bool async_pipeline_compile;
+    // bytes of transient textures and buffers kept allocated, together and each on their own, 0 is unlimited. idle ones
+    // are freed least recently used first at the start of a frame until back under budget
+    uint64_t transient_memory_budget;
+    uint64_t transient_texture_budget;
+    uint64_t transient_buffer_budget;
+    // transient textures are allocated with width and height rounded up to a multiple of this, so sizes that drift
+    // a little from frame to frame (dynamic resolution) keep reusing one texture. 0 allocates the exact size
+    uint16_t transient_texture_size_bucket;
 } oval_device_descriptor;
 
 typedef struct oval_device_t {
@@ -83,6 +96,25 @@ void oval_runloop(oval_device_t* device);
 void oval_free_device(oval_device_t* device);
 void oval_render_debug_capture(oval_device_t* device);
 void oval_query_render_profile(oval_device_t* device, uint32_t* length, const char*** names, const float** durations);
+void oval_query_transient_memory(oval_device_t* device, HGEGraphics::TransientMemoryReport* report);
+void oval_query_attachment_traffic(oval_device_t* device, HGEGraphics::AttachmentTrafficReport* report);
+void oval_query_barriers(oval_device_t* device, HGEGraphics::BarrierReport* report);
+// textures and buffers allocated for transient resources, shared by all frames in flight
+void oval_query_transient_residency(oval_device_t* device, HGEGraphics::ResourcePoolStats* textures, HGEGraphics::ResourcePoolStats* buffers);
+// transient textures and buffers together against transient_memory_budget, with the peak since the device was created
+void oval_query_transient_budget(oval_device_t* device, HGEGraphics::ResourceBudget* budget);
+// pipelines shared by all frames in flight, misses and creation times show the hitches caused by pipeline creation
+void oval_query_pipeline_cache(oval_device_t* device, HGEGraphics::ResourcePoolStats* graphics, HGEGraphics::ResourcePoolStats* compute);
+// records every pipeline created from now on into a manifest, oval_end_pipeline_manifest writes it to path
+void oval_begin_pipeline_manifest(oval_device_t* device);
+bool oval_end_pipeline_manifest(oval_device_t* device, const char* path);
+// creates the pipelines of a manifest for the shaders loaded so far on the task workers, returns once they are created.
+// a loading screen can replay the manifest of a level after loading its shaders
+bool oval_replay_pipeline_manifest(oval_device_t* device, const char* path);
+// graphics pipelines still compiling asynchronously
+uint32_t oval_query_compiling_pipelines(oval_device_t* device);
+// graphics pipelines created ahead of time by a cache or a manifest and not drawn with yet
+uint32_t oval_query_prepared_pipelines(oval_device_t* device);
 
 HGEGraphics::Texture* oval_create_texture(oval_device_t* device, const CGPUTextureDescriptor& desc);
 HGEGraphics::Texture* oval_create_texture_from_buffer(oval_device_t* device, const CGPUTextureDescriptor& desc, void* data, uint64_t size);
@@ -105,6 +137,8 @@ HGEGraphics::Material* oval_create_material(oval_device_t* device, HGEGraphics::
 void oval_free_material(oval_device_t* device, HGEGraphics::Material* material);
 bool oval_texture_prepared(oval_device_t* device, HGEGraphics::Texture* texture);
 bool oval_mesh_prepared(oval_device_t* device, HGEGraphics::Mesh* mesh);
+// false while a pipeline requested for the shader compiles asynchronously
+bool oval_shader_prepared(oval_device_t* device, HGEGraphics::Shader* shader);
 HGEGraphics::Buffer* oval_mesh_get_vertex_buffer(oval_device_t* device, HGEGraphics::Mesh* mesh);
 oval_graphics_transfer_queue_t oval_graphics_transfer_queue_alloc(oval_device_t* device);
 void oval_graphics_transfer_queue_submit(oval_device_t* device, oval_graphics_transfer_queue_t queue);
@@ -6,6 +6,7 @@
 #include "renderdoc_helper.h"
 #include <queue>
 #include "renderer.h"
+#include "rendergraph_compiler.h"
 #include <taskflow/taskflow.hpp>
 #include "imgui_threaded_rendering.h"
 
@@ -45,8 +46,8 @@ struct FrameData
 	CGPUFenceId inflightFence;
 	HGEGraphics::ExecutorContext execContext;
 
-	FrameData(CGPUDeviceId device, CGPUQueueId gfx_queue, bool profile, std::pmr::memory_resource* memory_resource)
-		: execContext(device, gfx_queue, profile, memory_resource)
+	FrameData(CGPUDeviceId device, CGPUQueueId gfx_queue, CGPUQueueId compute_queue, HGEGraphics::SharedResourcePools* shared_pools, bool profile, std::pmr::memory_resource* memory_resource)
+		: execContext(device, gfx_queue, profile, memory_resource, compute_queue, shared_pools)
 	{
 		inflightFence = cgpu_device_create_fence(device);
 	}
@@ -106,7 +107,7 @@ struct TexturedVertex
 
 typedef struct oval_cgpu_device_t {
 	oval_cgpu_device_t(const oval_device_t& super, std::pmr::memory_resource* memory_resource)
-		: super(super), memory_resource(memory_resource), transfer_queue(memory_resource), allocator(memory_resource), wait_load_resources(memory_resource)
+		: super(super), memory_resource(memory_resource), transfer_queue(memory_resource), allocator(memory_resource), wait_load_resources(memory_resource), compiled_graph_cache(10, memory_resource)
 	{
 	}
 
@@ -118,6 +119,7 @@ typedef struct oval_cgpu_device_t {
 	CGPUDeviceId device;
 	CGPUQueueId gfx_queue;
 	CGPUQueueId present_queue;
+	CGPUQueueId compute_queue = CGPU_NULLPTR;
 
 	CGPUSurfaceId surface;
 	CGPUSwapChainId swapchain;
@@ -125,8 +127,17 @@ typedef struct oval_cgpu_device_t {
 	std::vector<CGPUSemaphoreId> swapchain_prepared_semaphores;
 	std::vector<CGPUSemaphoreId> render_finished_semaphores;
 
+	HGEGraphics::SharedResourcePools* shared_pools = nullptr;
+	// empty when there is no place to keep the pipeline cache
+	std::string pipeline_cache_path;
+	// records the pipelines created between oval_begin_pipeline_manifest and oval_end_pipeline_manifest
+	HGEGraphics::PipelineCache* pipeline_manifest = nullptr;
 	std::vector<FrameData> frameDatas;
 	uint32_t current_frame_index;
+	HGEGraphics::CompiledRenderGraphCache compiled_graph_cache;
+	HGEGraphics::TransientMemoryReport transient_memory_report;
+	HGEGraphics::AttachmentTrafficReport attachment_traffic_report;
+	HGEGraphics::BarrierReport barrier_report;
 	FrameInfo info;
 
 	HGEGraphics::Shader* blit_shader = nullptr;
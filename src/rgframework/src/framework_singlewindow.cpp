@@ -11,6 +11,7 @@
 #include "mimalloc.h"
 #include <thread>
 #include <chrono>
+#include <filesystem>
 #ifdef __ANDROID__
 #include "jni.h"
 #endif
@@ -76,6 +77,49 @@ void oval_free_aligned(void* user_data, void* ptr, const void* pool)
 	mi_free_aligned(ptr, 1);
 }
 
+bool oval_read_pipeline_cache(oval_cgpu_device_t* D, const char* path, const HGEGraphics::PipelineCacheIdentity& identity, HGEGraphics::PipelineCache& cache)
+{
+	SDL_RWops* rw = SDL_RWFromFile(path, "rb");
+	if (!rw)
+		return false;
+
+	auto size = SDL_RWsize(rw);
+	std::pmr::vector<uint8_t> blob(size > 0 ? size : 0, D->memory_resource);
+	bool read = SDL_RWread(rw, blob.data(), 1, blob.size()) == blob.size();
+	SDL_RWclose(rw);
+
+	if (!read || !cache.deserialize(identity, blob.data(), blob.size()))
+	{
+		SDL_LogInfo(SDL_LOG_CATEGORY_RENDER, "%s is out of date or damaged, ignored", path);
+		return false;
+	}
+	return true;
+}
+
+bool oval_write_pipeline_cache(oval_cgpu_device_t* D, const char* path, const HGEGraphics::PipelineCacheIdentity& identity, const HGEGraphics::PipelineCache& cache)
+{
+	std::pmr::string blob(D->memory_resource);
+	cache.serialize(identity, blob);
+
+	// written next to the file and renamed over it, an interrupted save leaves the previous file intact
+	auto temp_path = std::string(path) + ".tmp";
+	SDL_RWops* rw = SDL_RWFromFile(temp_path.c_str(), "wb");
+	if (!rw)
+		return false;
+	bool written = SDL_RWwrite(rw, blob.data(), 1, blob.size()) == blob.size();
+	written = SDL_RWclose(rw) == 0 && written;
+
+	std::error_code error;
+	if (written)
+		std::filesystem::rename(temp_path, path, error);
+	if (!written || error)
+	{
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+	return true;
+}
+
 oval_device_t* oval_create_device(const oval_device_descriptor* device_descriptor)
 {
 	SDL_SetHint(SDL_HINT_VIDEO_EXTERNAL_CONTEXT, "1");
@@ -109,6 +153,7 @@ oval_device_t* oval_create_device(const oval_device_descriptor* device_descripto
 	auto memory_resource = new std::pmr::unsynchronized_pool_resource();
 	auto device_cgpu = new oval_cgpu_device_t(super, memory_resource);
 	device_cgpu->window = window;
+	device_cgpu->compiled_graph_cache.schedule = descriptor.reorder_passes ? HGEGraphics::PassSchedule::MinimizeBarriers : HGEGraphics::PassSchedule::Declaration;
 
 	if (device_descriptor->enable_capture)
 	{
@@ -151,17 +196,26 @@ oval_device_t* oval_create_device(const oval_device_descriptor* device_descripto
 	auto adapter = adapters[0];
 
 	// Create device
-	CGPUQueueGroupDescriptor G = {
-		.queue_type = CGPU_QUEUE_TYPE_GRAPHICS,
-		.queue_count = 1
+	bool async_compute = descriptor.async_compute && cgpu_query_queue_count(adapter, CGPU_QUEUE_TYPE_COMPUTE) > 0;
+	CGPUQueueGroupDescriptor G[2] = {
+		{
+			.queue_type = CGPU_QUEUE_TYPE_GRAPHICS,
+			.queue_count = 1
+		},
+		{
+			.queue_type = CGPU_QUEUE_TYPE_COMPUTE,
+			.queue_count = 1
+		},
 	};
 	CGPUDeviceDescriptor device_desc = {
-		.queue_group_count = 1,
-		.p_queue_groups = &G,
+		.queue_group_count = async_compute ? 2u : 1u,
+		.p_queue_groups = G,
 	};
 	device_cgpu->device = cgpu_adapter_create_device(adapter, &device_desc);
 	device_cgpu->gfx_queue = cgpu_device_get_queue(device_cgpu->device, CGPU_QUEUE_TYPE_GRAPHICS, 0);
 	device_cgpu->present_queue = device_cgpu->gfx_queue;
+	device_cgpu->compute_queue = async_compute ? cgpu_device_get_queue(device_cgpu->device, CGPU_QUEUE_TYPE_COMPUTE, 0) : CGPU_NULLPTR;
+	device_cgpu->compiled_graph_cache.async_compute = async_compute;
 	free(adapters);
 	SDL_SysWMinfo wmInfo;
 	SDL_VERSION(&wmInfo.version);
@@ -218,10 +272,29 @@ oval_device_t* oval_create_device(const oval_device_descriptor* device_descripto
 		device_cgpu->default_texture = oval_create_texture_from_buffer(&device_cgpu->super, default_texture_desc, colors, sizeof(colors));
 	}
 
+	device_cgpu->shared_pools = device_cgpu->allocator.new_object<HGEGraphics::SharedResourcePools>(device_cgpu->device, device_cgpu->gfx_queue, 3, device_cgpu->memory_resource);
 	for (uint32_t i = 0; i < 3; ++i)
 	{
-		device_cgpu->frameDatas.emplace_back(device_cgpu->device, device_cgpu->gfx_queue, device_cgpu->super.descriptor.enable_profile, device_cgpu->memory_resource);
+		device_cgpu->frameDatas.emplace_back(device_cgpu->device, device_cgpu->gfx_queue, device_cgpu->compute_queue, device_cgpu->shared_pools, device_cgpu->super.descriptor.enable_profile, device_cgpu->memory_resource);
 		device_cgpu->frameDatas[i].execContext.default_texture = device_cgpu->default_texture->view;
+		device_cgpu->frameDatas[i].execContext.texturePool.setSizeBucketing(device_cgpu->super.descriptor.transient_texture_size_bucket);
+	}
+	// only once the frames stopped moving around in the vector
+	for (auto& frame_data : device_cgpu->frameDatas)
+		device_cgpu->shared_pools->texturePool.addDependentContext(&frame_data.execContext);
+
+	device_cgpu->shared_pools->transientBudget.limit_bytes = device_cgpu->super.descriptor.transient_memory_budget;
+	device_cgpu->shared_pools->texturePool.setBudget(device_cgpu->super.descriptor.transient_texture_budget);
+	device_cgpu->shared_pools->bufferPool.setBudget(device_cgpu->super.descriptor.transient_buffer_budget);
+
+	if (device_cgpu->super.descriptor.async_pipeline_compile)
+		device_cgpu->shared_pools->pipelinePool.setCompileExecutor(&device_cgpu->taskExecutor);
+
+	if (char* base_path = SDL_GetBasePath())
+	{
+		device_cgpu->pipeline_cache_path = std::string(base_path) + "pipeline_cache.bin";
+		SDL_free(base_path);
+		oval_read_pipeline_cache(device_cgpu, device_cgpu->pipeline_cache_path.c_str(), HGEGraphics::pipeline_cache_identity(device_cgpu->device), device_cgpu->shared_pools->pipelineCache);
 	}
 
 	IMGUI_CHECKVERSION();
@@ -518,8 +591,12 @@ void render(oval_cgpu_device_t* device, const oval_submit_context& submit_contex
 
 	rendergraph_present(&rg, rg_back_buffer);
 
-	auto compiled = Compiler::Compile(rg, &rg_pool);
-	Executor::Execute(compiled, device->frameDatas[device->current_frame_index].execContext);
+	auto& compiled = device->compiled_graph_cache.compile(rg);
+	Executor::Execute(compiled, device->frameDatas[device->current_frame_index].execContext, &device->taskExecutor);
+	device->transient_memory_report = compiled.transient_memory;
+	device->attachment_traffic_report = compiled.attachment_traffic;
+	device->barrier_report = compiled.barrier_report;
+	device->compiled_graph_cache.newFrame();
 
 	for (auto imported : rg.imported_textures)
 	{
@@ -641,6 +718,8 @@ void oval_runloop(oval_device_t* device)
 		if (requestResize)
 		{
 			cgpu_queue_wait_idle(D->gfx_queue);
+			if (D->compute_queue)
+				cgpu_queue_wait_idle(D->compute_queue);
 			requestResize = !on_resize(D);
 		}
 
@@ -650,6 +729,13 @@ void oval_runloop(oval_device_t* device)
 		auto& cur_frame_data = D->frameDatas[D->current_frame_index];
 		cgpu_wait_fences(1, &cur_frame_data.inflightFence);
 		cur_frame_data.newFrame();
+		D->shared_pools->newFrame();
+		// frames the gpu already finished give back their transient resources before this one allocates
+		for (auto& frame_data : D->frameDatas)
+		{
+			if (&frame_data != &cur_frame_data && cgpu_query_fence_status(frame_data.inflightFence) == CGPU_FENCE_STATUS_COMPLETE)
+				frame_data.execContext.recycleTransientResources();
+		}
 		D->info.reset();
 
 		CGPUAcquireNextDescriptor acquire_desc = {
@@ -754,16 +840,37 @@ void oval_runloop(oval_device_t* device)
 				render(D, submit_context, back_buffer);
 
 				auto render_finished_semaphore = D->render_finished_semaphores[D->info.current_swapchain_index];
-				CGPUQueueSubmitDescriptor submit_desc = {
-					.cmd_count = (uint32_t)cur_frame_data.execContext.allocated_cmds.size(),
-					.p_cmds = cur_frame_data.execContext.allocated_cmds.data(),
-					.signal_fence = cur_frame_data.inflightFence,
-					.wait_semaphore_count = 1,
-					.p_wait_semaphores = &prepared_semaphore,
-					.signal_semaphore_count = 1,
-					.p_signal_semaphores = &render_finished_semaphore,
-				};
-				cgpu_queue_submit(D->gfx_queue, &submit_desc);
+				auto& submit_cmds = cur_frame_data.execContext.submit_cmds;
+				auto& submit_batches = cur_frame_data.execContext.submit_batches;
+				for (size_t i = 0; i < submit_batches.size(); ++i)
+				{
+					// the first batch waits for the swapchain image, the last one signals the frame fence
+					auto& batch = submit_batches[i];
+					bool first = i == 0, last = i + 1 == submit_batches.size();
+					CGPUSemaphoreId wait_semaphores[2];
+					uint32_t wait_semaphore_count = 0;
+					if (first)
+						wait_semaphores[wait_semaphore_count++] = prepared_semaphore;
+					if (batch.wait_semaphore)
+						wait_semaphores[wait_semaphore_count++] = batch.wait_semaphore;
+					CGPUSemaphoreId signal_semaphores[2];
+					uint32_t signal_semaphore_count = 0;
+					if (last)
+						signal_semaphores[signal_semaphore_count++] = render_finished_semaphore;
+					if (batch.signal_semaphore)
+						signal_semaphores[signal_semaphore_count++] = batch.signal_semaphore;
+
+					CGPUQueueSubmitDescriptor submit_desc = {
+						.cmd_count = batch.cmd_count,
+						.p_cmds = submit_cmds.data() + batch.first_cmd,
+						.signal_fence = last ? cur_frame_data.inflightFence : CGPU_NULLPTR,
+						.wait_semaphore_count = wait_semaphore_count,
+						.p_wait_semaphores = wait_semaphores,
+						.signal_semaphore_count = signal_semaphore_count,
+						.p_signal_semaphores = signal_semaphores,
+					};
+					cgpu_queue_submit(batch.queue == CGPU_QUEUE_TYPE_COMPUTE ? D->compute_queue : D->gfx_queue, &submit_desc);
+				}
 
 				CGPUQueuePresentDescriptor present_desc = {
 					.swapchain = D->swapchain,
@@ -826,6 +933,8 @@ void oval_runloop(oval_device_t* device)
 	}
 
 	cgpu_queue_wait_idle(D->gfx_queue);
+	if (D->compute_queue)
+		cgpu_queue_wait_idle(D->compute_queue);
 
 	for (int i = 0; i < 3; ++i)
 	{
@@ -874,8 +983,22 @@ void oval_free_device(oval_device_t* device)
 
 	for (int i = 0; i < D->frameDatas.size(); ++i)
 	{
+		D->shared_pools->texturePool.removeDependentContext(&D->frameDatas[i].execContext);
 		D->frameDatas[i].free();
 	}
+	if (D->pipeline_manifest)
+	{
+		D->shared_pools->pipelinePool.setPipelineManifest(nullptr);
+		D->shared_pools->computePipelinePool.setPipelineManifest(nullptr);
+		D->allocator.delete_object(D->pipeline_manifest);
+		D->pipeline_manifest = nullptr;
+	}
+	if (!D->pipeline_cache_path.empty())
+		oval_write_pipeline_cache(D, D->pipeline_cache_path.c_str(), HGEGraphics::pipeline_cache_identity(D->device), D->shared_pools->pipelineCache);
+	D->shared_pools->destroy();
+	D->allocator.delete_object(D->shared_pools);
+	D->shared_pools = nullptr;
+	D->compiled_graph_cache.destroy();
 
 	D->materials.clear();
 	D->meshes.clear();
@@ -888,6 +1011,9 @@ void oval_free_device(oval_device_t* device)
 
 	cgpu_device_free_queue(D->device, D->gfx_queue);
 	D->gfx_queue = CGPU_NULLPTR;
+	if (D->compute_queue)
+		cgpu_device_free_queue(D->device, D->compute_queue);
+	D->compute_queue = CGPU_NULLPTR;
 	D->present_queue = CGPU_NULLPTR;
 	cgpu_adapter_free_device(D->device->adapter, D->device);
 	D->device = CGPU_NULLPTR;
@@ -927,3 +1053,114 @@ void oval_query_render_profile(oval_device_t* device, uint32_t* length, const ch
 		*durations = nullptr;
 	}
 }
+
+void oval_query_transient_memory(oval_device_t* device, HGEGraphics::TransientMemoryReport* report)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	*report = D->transient_memory_report;
+}
+
+void oval_query_attachment_traffic(oval_device_t* device, HGEGraphics::AttachmentTrafficReport* report)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	*report = D->attachment_traffic_report;
+}
+
+void oval_query_barriers(oval_device_t* device, HGEGraphics::BarrierReport* report)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	*report = D->barrier_report;
+}
+
+void oval_query_transient_residency(oval_device_t* device, HGEGraphics::ResourcePoolStats* textures, HGEGraphics::ResourcePoolStats* buffers)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	*textures = D->shared_pools->texturePool.stats();
+	*buffers = D->shared_pools->bufferPool.stats();
+	// released by frames still in flight, they go back to the shared pools once those frames finish
+	for (auto& frame_data : D->frameDatas)
+	{
+		auto frame_textures = frame_data.execContext.texturePool.stats();
+		textures->idle_count += frame_textures.idle_count;
+		textures->idle_bytes += frame_textures.idle_bytes;
+		auto frame_buffers = frame_data.execContext.bufferPool.stats();
+		buffers->idle_count += frame_buffers.idle_count;
+		buffers->idle_bytes += frame_buffers.idle_bytes;
+	}
+}
+
+void oval_query_transient_budget(oval_device_t* device, HGEGraphics::ResourceBudget* budget)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	*budget = D->shared_pools->transientBudget;
+}
+
+void oval_query_pipeline_cache(oval_device_t* device, HGEGraphics::ResourcePoolStats* graphics, HGEGraphics::ResourcePoolStats* compute)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	std::lock_guard<std::mutex> lock(D->shared_pools->pipeline_mutex);
+	*graphics = D->shared_pools->pipelinePool.stats();
+	*compute = D->shared_pools->computePipelinePool.stats();
+}
+
+void oval_begin_pipeline_manifest(oval_device_t* device)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	std::lock_guard<std::mutex> lock(D->shared_pools->pipeline_mutex);
+	if (!D->pipeline_manifest)
+		D->pipeline_manifest = D->allocator.new_object<HGEGraphics::PipelineCache>(D->memory_resource);
+	D->shared_pools->pipelinePool.setPipelineManifest(D->pipeline_manifest);
+	D->shared_pools->computePipelinePool.setPipelineManifest(D->pipeline_manifest);
+}
+
+bool oval_end_pipeline_manifest(oval_device_t* device, const char* path)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	HGEGraphics::PipelineCache* manifest;
+	{
+		std::lock_guard<std::mutex> lock(D->shared_pools->pipeline_mutex);
+		manifest = D->pipeline_manifest;
+		D->pipeline_manifest = nullptr;
+		D->shared_pools->pipelinePool.setPipelineManifest(nullptr);
+		D->shared_pools->computePipelinePool.setPipelineManifest(nullptr);
+	}
+	if (!manifest)
+		return false;
+
+	// manifests carry no identity, they describe content and are valid on any device
+	bool written = oval_write_pipeline_cache(D, path, {}, *manifest);
+	D->allocator.delete_object(manifest);
+	return written;
+}
+
+bool oval_replay_pipeline_manifest(oval_device_t* device, const char* path)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	HGEGraphics::PipelineCache manifest(D->memory_resource);
+	if (!oval_read_pipeline_cache(D, path, {}, manifest))
+		return false;
+
+	std::pmr::vector<HGEGraphics::Shader*> shaders(D->memory_resource);
+	for (auto& shader : D->shaders)
+		shaders.push_back(shader.get());
+	std::pmr::vector<HGEGraphics::ComputeShader*> compute_shaders(D->memory_resource);
+	for (auto& shader : D->computeShaders)
+		compute_shaders.push_back(shader.get());
+
+	D->shared_pools->preparePipelines(manifest, shaders, &D->taskExecutor);
+	D->shared_pools->preparePipelines(manifest, compute_shaders);
+	return true;
+}
+
+uint32_t oval_query_compiling_pipelines(oval_device_t* device)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	return D->shared_pools->pipelinePool.compilingCount();
+}
+
+uint32_t oval_query_prepared_pipelines(oval_device_t* device)
+{
+	auto D = (oval_cgpu_device_t*)device;
+	std::lock_guard<std::mutex> lock(D->shared_pools->pipeline_mutex);
+	return D->shared_pools->pipelinePool.preparedCount();
+}
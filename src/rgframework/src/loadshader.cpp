@@ -15,6 +15,8 @@ HGEGraphics::Shader* oval_create_shader(oval_device_t* device, const uint8_t* ve
 		blend_desc, depth_desc, rasterizer_state);
 	auto ptr = shader.get();
 	D->shaders.push_back(std::move(shader));
+	if (D->shared_pools)
+		D->shared_pools->preparePipelines(ptr);
 	return ptr;
 }
 
@@ -30,6 +32,8 @@ HGEGraphics::ComputeShader* oval_create_compute_shader(oval_device_t* device, co
 	auto computeShader = HGEGraphics::create_compute_shader(D->device, reinterpret_cast<const uint8_t*>(compShaderCode.data()), compShaderCode.size());
 	auto ptr = computeShader.get();
 	D->computeShaders.push_back(std::move(computeShader));
+	if (D->shared_pools)
+		D->shared_pools->preparePipelines(ptr);
 	return ptr;
 }
 
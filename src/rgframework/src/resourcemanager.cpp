@@ -106,6 +106,11 @@ bool oval_mesh_prepared(oval_device_t* device, HGEGraphics::Mesh* mesh)
 	return mesh->prepared;
 }
 
+bool oval_shader_prepared(oval_device_t* device, HGEGraphics::Shader* shader)
+{
+	return shader->compiling_pipelines.load() == 0;
+}
+
 HGEGraphics::Buffer* oval_mesh_get_vertex_buffer(oval_device_t* device, HGEGraphics::Mesh* mesh)
 {
 	return mesh->vertex_buffer.get();
@@ -0,0 +1,201 @@
+#include "framework.h"
+#include "SDL.h"
+#include <stdio.h>
+
+// replays a manifest once the render passes its pipelines were recorded with have expired from the shared pools, then
+// draws once the render passes the replay created have expired too. the draw has to take the prepared pipelines
+
+// the frames in flight of the framework, shared pools expire what is idle for 12 times as many frames
+const uint32_t frames_in_flight = 3;
+const uint32_t expire_frames = 12 * frames_in_flight + frames_in_flight + 1;
+const uint32_t record_frames = 2;
+const uint32_t replay_frame = record_frames + expire_frames;
+const uint32_t draw_frame = replay_frame + expire_frames;
+const char* manifest_path = "pipeline_manifest_test.bin";
+
+struct Application
+{
+	oval_device_t* device;
+	HGEGraphics::Shader* shader;
+	HGEGraphics::Shader* light_shader;
+	HGEGraphics::texture_handle_t gbuffer;
+	CGPUSamplerId gbuffer_sampler = CGPU_NULLPTR;
+	uint32_t frame = 0;
+	uint32_t prepared_before_replay = 0;
+	uint32_t prepared_after_replay = 0;
+	bool failed = false;
+};
+
+void _init(Application& app)
+{
+	CGPUBlendAttachmentState blend_attachments = {
+		.enable = false,
+		.src_factor = CGPU_BLEND_FACTOR_ONE,
+		.dst_factor = CGPU_BLEND_FACTOR_ZERO,
+		.src_alpha_factor = CGPU_BLEND_FACTOR_ONE,
+		.dst_alpha_factor = CGPU_BLEND_FACTOR_ZERO,
+		.blend_op = CGPU_BLEND_OP_ADD,
+		.blend_alpha_op = CGPU_BLEND_OP_ADD,
+		.color_mask = CGPU_COLOR_MASK_RGBA,
+	};
+	CGPUBlendStateDescriptor blend_desc = {
+		.attachment_count = 1,
+		.p_attachments = &blend_attachments,
+		.alpha_to_coverage = false,
+		.independent_blend = false,
+	};
+	CGPUDepthStateDescriptor depth_desc = {
+		.depth_test = false,
+		.depth_write = false,
+		.stencil_test = false,
+	};
+	CGPURasterizerStateDescriptor rasterizer_state = {
+		.cull_mode = CGPU_CULL_MODE_NONE,
+	};
+	app.shader = oval_create_shader(app.device, "shaderbin/hello.vert.spv", "shaderbin/hello.frag.spv", blend_desc, depth_desc, rasterizer_state);
+	app.light_shader = oval_create_shader(app.device, "shaderbin/light.vert.spv", "shaderbin/light.frag.spv", blend_desc, depth_desc, rasterizer_state);
+
+	CGPUSamplerDescriptor gbuffer_sampler_desc = {
+		.min_filter = CGPU_FILTER_TYPE_LINEAR,
+		.mag_filter = CGPU_FILTER_TYPE_LINEAR,
+		.mipmap_mode = CGPU_MIP_MAP_MODE_LINEAR,
+		.address_u = CGPU_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.address_v = CGPU_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.address_w = CGPU_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.mip_lod_bias = 0,
+		.max_anisotropy = 1,
+	};
+	app.gbuffer_sampler = oval_create_sampler(app.device, &gbuffer_sampler_desc);
+}
+
+void _free(Application& app)
+{
+	oval_free_shader(app.device, app.shader);
+	app.shader = nullptr;
+
+	oval_free_shader(app.device, app.light_shader);
+	app.light_shader = nullptr;
+
+	oval_free_sampler(app.device, app.gbuffer_sampler);
+	app.gbuffer_sampler = nullptr;
+}
+
+void _draw(Application* app, HGEGraphics::rendergraph_t& rg, HGEGraphics::texture_handle_t rg_back_buffer)
+{
+	using namespace HGEGraphics;
+
+	// an offscreen pass, nothing else keeps its render pass alive in the shared pools
+	auto gbuffer = rendergraph_declare_texture(&rg);
+	rg_texture_set_extent(&rg, gbuffer, rg_texture_get_width(&rg, rg_back_buffer), rg_texture_get_height(&rg, rg_back_buffer));
+	rg_texture_set_format(&rg, gbuffer, CGPU_TEXTURE_FORMAT_R16G16B16A16_SFLOAT);
+
+	auto gPassBuilder = rendergraph_add_renderpass(&rg, "GPass");
+	renderpass_add_color_attachment(&gPassBuilder, gbuffer, CGPU_LOAD_ACTION_CLEAR, 0, CGPU_STORE_ACTION_STORE);
+	struct PassData
+	{
+		Application* app;
+	};
+	PassData* passdata;
+	renderpass_set_executable(&gPassBuilder, [](RenderPassEncoder* encoder, void* userdata)
+		{
+			Application* app = ((PassData*)userdata)->app;
+			draw_procedure(encoder, app->shader, CGPU_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 3);
+		}, sizeof(PassData), (void**)&passdata);
+	passdata->app = app;
+
+	auto passBuilder = rendergraph_add_renderpass(&rg, "Main Pass");
+	renderpass_add_color_attachment(&passBuilder, rg_back_buffer, CGPU_LOAD_ACTION_CLEAR, 0xffffffff, CGPU_STORE_ACTION_STORE);
+	renderpass_sample(&passBuilder, gbuffer);
+	app->gbuffer = gbuffer;
+
+	PassData* passdata2;
+	renderpass_set_executable(&passBuilder, [](RenderPassEncoder* encoder, void* userdata)
+		{
+			Application* app = ((PassData*)userdata)->app;
+			set_global_texture_handle(encoder, app->gbuffer, 0, 0);
+			set_global_sampler(encoder, app->gbuffer_sampler, 0, 1);
+			draw_procedure(encoder, app->light_shader, CGPU_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 3);
+		}, sizeof(PassData), (void**)&passdata2);
+	passdata2->app = app;
+}
+
+void _quit(Application* app, const char* message)
+{
+	if (message)
+	{
+		fprintf(stderr, "pipeline_manifest: %s\n", message);
+		app->failed = true;
+	}
+	SDL_Event e = {};
+	e.type = SDL_QUIT;
+	SDL_PushEvent(&e);
+}
+
+void on_submit(oval_device_t* device, oval_submit_context submit_context, HGEGraphics::rendergraph_t& rg, HGEGraphics::texture_handle_t rg_back_buffer)
+{
+	Application* app = (Application*)device->descriptor.userdata;
+	uint32_t frame = app->frame++;
+
+	if (frame == 0)
+		oval_begin_pipeline_manifest(device);
+
+	if (frame < record_frames)
+	{
+		_draw(app, rg, rg_back_buffer);
+	}
+	else if (frame == record_frames)
+	{
+		if (!oval_end_pipeline_manifest(device, manifest_path))
+			_quit(app, "the manifest was not written");
+	}
+	else if (frame == replay_frame)
+	{
+		// a cache from an earlier run may have prepared pipelines for other render passes, only the difference counts
+		app->prepared_before_replay = oval_query_prepared_pipelines(device);
+		if (!oval_replay_pipeline_manifest(device, manifest_path))
+			_quit(app, "the manifest was not read back");
+		app->prepared_after_replay = oval_query_prepared_pipelines(device);
+		if (app->prepared_after_replay <= app->prepared_before_replay)
+			_quit(app, "the replay prepared no pipeline");
+	}
+	else if (frame == draw_frame)
+	{
+		_draw(app, rg, rg_back_buffer);
+	}
+	else if (frame == draw_frame + 1)
+	{
+		// a draw not finding its prepared pipelines creates its own and leaves them behind
+		if (oval_query_prepared_pipelines(device) != app->prepared_before_replay)
+			_quit(app, "the draw did not take the prepared pipelines");
+		else
+			_quit(app, nullptr);
+	}
+}
+
+#ifdef __cplusplus
+extern "C"
+#endif
+int SDL_main(int argc, char* argv[])
+{
+	const int width = 800;
+	const int height = 600;
+	Application app;
+	oval_device_descriptor device_descriptor =
+	{
+		.userdata = &app,
+		.on_submit = on_submit,
+		.width = width,
+		.height = height,
+		.enable_capture = false,
+		.enable_profile = false,
+	};
+	app.device = oval_create_device(&device_descriptor);
+	if (!app.device)
+		return 1;
+	_init(app);
+	oval_runloop(app.device);
+	_free(app);
+	oval_free_device(app.device);
+
+	return app.failed ? 1 : 0;
+}
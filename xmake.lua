@@ -32,6 +32,7 @@ includes("cgpu/xmake.lua")
 target("rendergraph")
     set_kind("static")
     add_deps("cgpu")
+    add_packages("taskflow")
     add_includedirs("src/rendergraph/include", {public = true})
     add_headerfiles("src/rendergraph/include/*.h")
     add_headerfiles("src/rendergraph/src/*.h", {install = false})
@@ -122,3 +123,20 @@ target("rendersystem")
     end
     add_packages("entt")
     add_files("examples/rendersystem/*.cpp")
+
+rule("test_base")
+    after_load(function(target)
+        target:set("group", "tests")
+        target:set("kind", "binary")
+        if is_plat("windows") then
+            target:add("ldflags", "/subsystem:console")
+        end
+        target:set("rundir", "$(projectdir)/examples/assets")
+        target:add("deps", "rgframework")
+    end)
+
+target("pipeline_manifest_test")
+    add_rules("test_base")
+    set_enabled(not is_plat("android"))
+    add_files("tests/pipeline_manifest/*.cpp")
+    add_tests("default")